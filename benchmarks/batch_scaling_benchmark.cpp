@@ -0,0 +1,89 @@
+#include "test_support.hpp"
+#include "totp_manager.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Scaling curve of batch generation: requests answered from one AccountStore in generate_batch()'s
+// chunk size on work-stealing pools of 1..N threads, then generate_batch() on its host-sized pool.
+// Speedup is against one thread; efficiency is speedup per thread and should stay near 1 up to the
+// physical core count.
+
+namespace
+{
+constexpr size_t   d_account_count = 1'000;
+constexpr size_t   d_request_count = 2'000'000;
+constexpr uint64_t d_unix_time	   = 1'700'000'000;
+
+double measure(UTILS::WorkStealingPool& pool, const UTILS::AccountStore& accounts, const std::vector<UTILS::GenerateRequest>& requests, std::vector<uint32_t>& codes)
+{
+	return TESTS::seconds([&] {
+		pool.parallel_for(requests.size(), UTILS::d_batch_chunk_size, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				codes[i] = accounts.generate(accounts.find(requests[i].account_name), requests[i].unix_time);
+			}
+		});
+	});
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated() || !TESTS::write_settings("[totp]\naccount_name = \"\"\n"))
+	{
+		return 1;
+	}
+
+	auto manager = UTILS::TOTPManager::instance();
+
+	UTILS::AccountStore		 accounts;
+	std::vector<std::string> names;
+
+	for (size_t i = 0; i < d_account_count; ++i)
+	{
+		names.push_back("account-" + std::to_string(i));
+		accounts.add(names.back(), "JBSWY3DPEHPK3PXP", {});
+		manager->set_account(names.back(), "JBSWY3DPEHPK3PXP");
+	}
+
+	// Each account's timestamps listed together, as exports do.
+	std::vector<UTILS::GenerateRequest> requests;
+	requests.reserve(d_request_count);
+	for (size_t i = 0; i < d_request_count; ++i)
+	{
+		requests.push_back({names[i * d_account_count / d_request_count], d_unix_time + i * 30});
+	}
+
+	std::vector<uint32_t> codes(d_request_count);
+
+	const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	double		 single		 = 0;
+
+	std::printf("%8s %14s %9s %11s\n", "threads", "codes/s", "speedup", "efficiency");
+
+	for (size_t threads = 1; threads <= max_threads; ++threads)
+	{
+		UTILS::WorkStealingPool pool(threads);
+
+		const double elapsed = measure(pool, accounts, requests, codes);
+		single				 = threads == 1 ? elapsed : single;
+
+		std::printf("%8zu %14.0f %9.2f %11.2f\n", threads, d_request_count / elapsed, single / elapsed, single / elapsed / threads);
+	}
+
+	size_t		 generated = 0;
+	const double elapsed   = TESTS::seconds([&] { generated = manager->generate_batch(requests, codes); });
+
+	std::printf("%8s %14.0f %9.2f %11.2f  (TOTPManager::generate_batch)\n", "host", d_request_count / elapsed, single / elapsed, single / elapsed / max_threads);
+
+	TESTS::expect(generated == d_request_count, "generate_batch answers every request");
+
+	return TESTS::failure_count().load() != 0;
+}
@@ -0,0 +1,140 @@
+#include "settings_manager.hpp"
+#include "test_support.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The four reads NotificationManager makes per notification, through SettingsManager::get_setting()
+// and through SettingHandles, on 1..N threads. The last rows repeat the run while another thread
+// changes an unrelated setting every millisecond, so handles keep re-resolving their paths.
+
+namespace
+{
+constexpr size_t d_reads_per_thread = 250'000;
+constexpr auto	 d_change_interval	= std::chrono::milliseconds(1);
+
+constexpr const char* d_settings = "[notifications]\n"
+								   "enabled = \"true\"\n"
+								   "uri = \"https://ntfy.example.com/totp\"\n"
+								   "username = \"user\"\n"
+								   "password = \"password\"\n";
+
+// Runs read() d_reads_per_thread times on each of thread_count threads, each with its own state
+// from make_state(). Returns notifications' worth of reads per second over all threads.
+template<typename MakeState, typename Read>
+double measure(size_t thread_count, const MakeState& make_state, const Read& read)
+{
+	std::atomic<size_t> checksum = 0;
+
+	const double elapsed = TESTS::seconds([&] {
+		std::vector<std::thread> threads;
+		for (size_t thread = 0; thread < thread_count; ++thread)
+		{
+			threads.emplace_back([&] {
+				auto   state = make_state();
+				size_t sum	 = 0;
+				for (size_t i = 0; i < d_reads_per_thread; ++i)
+				{
+					sum += read(state);
+				}
+				checksum.fetch_add(sum, std::memory_order_relaxed);
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	});
+
+	return static_cast<double>(thread_count * d_reads_per_thread) / elapsed;
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated() || !TESTS::write_settings(d_settings))
+	{
+		return 1;
+	}
+
+	auto settings_manager = UTILS::SettingsManager::instance();
+
+	struct Handles
+	{
+		UTILS::SettingHandle<std::string> enabled;
+		UTILS::SettingHandle<std::string> uri;
+		UTILS::SettingHandle<std::string> username;
+		UTILS::SettingHandle<std::string> password;
+	};
+
+	const auto make_handles = [&] {
+		return Handles {settings_manager->get_handle<std::string>("notifications.enabled", "false"),
+						settings_manager->get_handle<std::string>("notifications.uri", ""),
+						settings_manager->get_handle<std::string>("notifications.username", ""),
+						settings_manager->get_handle<std::string>("notifications.password", "")};
+	};
+
+	const auto read_handles = [](const Handles& handles) {
+		return handles.enabled.get().size() + handles.uri.get().size() + handles.username.get().size() + handles.password.get().size();
+	};
+
+	const auto read_paths = [&](int) {
+		return settings_manager->get_setting<std::string>("notifications.enabled", "false").size() +
+			   settings_manager->get_setting<std::string>("notifications.uri", "").size() +
+			   settings_manager->get_setting<std::string>("notifications.username", "").size() +
+			   settings_manager->get_setting<std::string>("notifications.password", "").size();
+	};
+
+	TESTS::expect(read_handles(make_handles()) == read_paths(0), "handles and paths read the same values");
+
+	const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("%8s %8s %16s %16s %8s\n", "threads", "changes", "get_setting /s", "handle /s", "ratio");
+
+	for (bool changing : {false, true})
+	{
+		std::atomic<bool> done = false;
+		std::thread		  writer;
+
+		if (changing)
+		{
+			writer = std::thread([&] {
+				for (int64_t i = 0; !done.load(std::memory_order_relaxed); ++i)
+				{
+					settings_manager->set_setting<int64_t>("benchmark.counter", i, UTILS::SettingPersistence::TRANSIENT);
+					std::this_thread::sleep_for(d_change_interval);
+				}
+			});
+		}
+
+		for (size_t threads = 1;; threads = std::min(threads * 2, max_threads))
+		{
+			const double paths	 = measure(threads, [] { return 0; }, read_paths);
+			const double handles = measure(threads, make_handles, read_handles);
+
+			std::printf("%8zu %8s %16.0f %16.0f %8.2f\n", threads, changing ? "1/ms" : "none", paths, handles, handles / paths);
+
+			if (threads == max_threads)
+			{
+				break;
+			}
+		}
+
+		done.store(true, std::memory_order_relaxed);
+		if (writer.joinable())
+		{
+			writer.join();
+		}
+	}
+
+	return TESTS::failure_count().load() != 0;
+}
@@ -0,0 +1,86 @@
+#include "settings_cache.hpp"
+#include "test_support.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+// Cold-start cost of the settings: toml::parse() of the source text against load_settings_cache()
+// of its compiled image, for generated configurations of growing account counts. Both sides start
+// from the source text in memory, since the cache is validated against its hash. Best of
+// d_repetitions runs each.
+
+namespace
+{
+constexpr size_t  d_account_counts[] = {100, 1'000, 10'000, 50'000};
+constexpr size_t  d_repetitions		 = 5;
+constexpr int64_t d_source_time		 = 1'700'000'000;
+
+std::string make_source(size_t account_count)
+{
+	std::string source = "[application]\nsettings-cache = true\n\n[totp]\naccount_name = \"account-0\"\n\n";
+	for (size_t i = 0; i < account_count; ++i)
+	{
+		source += "[totp.accounts.account-" + std::to_string(i) + "]\n";
+		source += "secret = \"JBSWY3DPEHPK3PXP\"\nperiod = 30\ndigits = 6\nalgorithm = \"SHA1\"\n\n";
+	}
+	return source;
+}
+
+template<typename Body>
+double best_seconds(Body&& body)
+{
+	double best = 0;
+	for (size_t i = 0; i < d_repetitions; ++i)
+	{
+		const double elapsed = TESTS::seconds(body);
+		best				 = i == 0 ? elapsed : std::min(best, elapsed);
+	}
+	return best;
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated())
+	{
+		return 1;
+	}
+
+	const fs::path cache_path = UTILS::settings_cache_path(fs::path(std::getenv("PROJECT_TEST_HOME")) / "benchmark.toml");
+	fs::create_directories(cache_path.parent_path());
+
+	std::printf("%9s %10s %12s %12s %8s\n", "accounts", "source KiB", "parse ms", "cache ms", "ratio");
+
+	for (size_t account_count : d_account_counts)
+	{
+		const std::string source = make_source(account_count);
+
+		const toml::table		   parsed = toml::parse(source);
+		std::optional<std::string> image  = UTILS::compile_settings_cache(parsed);
+		if (!image)
+		{
+			TESTS::expect(false, "generated settings compile");
+			break;
+		}
+
+		UTILS::stamp_settings_cache(*image, d_source_time, source);
+		std::ofstream(cache_path, std::ios::binary | std::ios::trunc) << *image;
+
+		std::optional<toml::table> cached = UTILS::load_settings_cache(cache_path, d_source_time, source);
+		TESTS::expect(cached && *cached == parsed, "the cache loads the settings the source holds");
+
+		const double parse = best_seconds([&] { toml::table settings = toml::parse(source); });
+		const double cache = best_seconds([&] { std::optional<toml::table> settings = UTILS::load_settings_cache(cache_path, d_source_time, source); });
+
+		std::printf("%9zu %10zu %12.2f %12.2f %8.2f\n", account_count, source.size() / 1024, parse * 1e3, cache * 1e3, parse / cache);
+	}
+
+	fs::remove(cache_path);
+
+	return TESTS::failure_count().load() != 0;
+}
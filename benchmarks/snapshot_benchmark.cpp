@@ -0,0 +1,132 @@
+#include "test_support.hpp"
+#include "totp_manager.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Code generation throughput through TOTPManager's snapshots against the locked path they replaced,
+// with 1..N reader threads and a writer rotating the secret every millisecond. precompute_codes()
+// is never called, so the snapshot side computes every code like the locked side does.
+
+namespace
+{
+constexpr uint64_t d_unix_time		   = 1'700'000'000;
+constexpr size_t   d_reads_per_thread  = 200'000;
+constexpr auto	   d_rotation_interval = std::chrono::milliseconds(1);
+
+constexpr const char* d_secrets[] = {"JBSWY3DPEHPK3PXP", "GEZDGNBVGY3TQOJQ"};
+
+// One store and the selected account behind a mutex every reader and writer takes.
+class LockedAccounts
+{
+public:
+	void set_account(const std::string& account_name, const std::string& secret)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_accounts.add(account_name, secret, {});
+		m_account_name = account_name;
+	}
+
+	uint32_t generate(uint64_t unix_time) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_accounts.generate(m_accounts.find(m_account_name), unix_time);
+	}
+
+private:
+	mutable std::mutex	m_mutex;
+	UTILS::AccountStore m_accounts;
+	std::string			m_account_name;
+};
+
+// Runs read(unix_time) d_reads_per_thread times on each of reader_count threads while rotate(i)
+// runs every d_rotation_interval. Returns codes per second over all readers.
+template<typename Read, typename Rotate>
+double measure(size_t reader_count, const Read& read, const Rotate& rotate)
+{
+	std::atomic<bool>	  done	   = false;
+	std::atomic<uint32_t> checksum = 0;
+
+	std::thread writer([&] {
+		for (size_t i = 0; !done.load(std::memory_order_relaxed); ++i)
+		{
+			rotate(i);
+			std::this_thread::sleep_for(d_rotation_interval);
+		}
+	});
+
+	const double elapsed = TESTS::seconds([&] {
+		std::vector<std::thread> readers;
+		for (size_t reader = 0; reader < reader_count; ++reader)
+		{
+			readers.emplace_back([&, reader] {
+				uint32_t sum = 0;
+				for (size_t i = 0; i < d_reads_per_thread; ++i)
+				{
+					sum += read(d_unix_time + (reader * d_reads_per_thread + i) * 30);
+				}
+				checksum.fetch_add(sum, std::memory_order_relaxed);
+			});
+		}
+
+		for (auto& reader : readers)
+		{
+			reader.join();
+		}
+	});
+
+	done.store(true, std::memory_order_relaxed);
+	writer.join();
+
+	return static_cast<double>(reader_count * d_reads_per_thread) / elapsed;
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated() || !TESTS::write_settings("[totp]\naccount_name = \"\"\n"))
+	{
+		return 1;
+	}
+
+	auto manager = UTILS::TOTPManager::instance();
+	manager->set_account("benchmark", d_secrets[0]);
+
+	LockedAccounts locked;
+	locked.set_account("benchmark", d_secrets[0]);
+
+	const size_t max_readers = std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("%8s %16s %16s %8s\n", "readers", "snapshot code/s", "mutex code/s", "ratio");
+
+	for (size_t readers = 1;; readers = std::min(readers * 2, max_readers))
+	{
+		const double snapshot = measure(
+			readers,
+			[&](uint64_t unix_time) { return manager->generate_code("benchmark", unix_time).value_or(0); },
+			[&](size_t i) { manager->set_account("benchmark", d_secrets[i % 2]); });
+
+		const double mutex = measure(
+			readers,
+			[&](uint64_t unix_time) { return locked.generate(unix_time); },
+			[&](size_t i) { locked.set_account("benchmark", d_secrets[i % 2]); });
+
+		std::printf("%8zu %16.0f %16.0f %8.2f\n", readers, snapshot, mutex, snapshot / mutex);
+
+		if (readers == max_readers)
+		{
+			break;
+		}
+	}
+
+	return 0;
+}
@@ -36,8 +36,8 @@ include(cmake/libraries/fmt.cmake)
 include(cmake/libraries/spdlog.cmake)
 include(cmake/libraries/cxxopts.cmake)
 include(cmake/libraries/tomlplusplus.cmake)
-include(cmake/libraries/totp.cmake)
 include(cmake/libraries/common.cmake)
+include(cmake/libraries/totpclient.cmake)
 include(cmake/libraries/utils.cmake)
 include(cmake/libraries/app.cmake)
 
@@ -67,3 +67,7 @@ endif()
 source_group("Main" FILES ${PROJECT_MAIN_SRC_FILES})
 
 include(cmake/utils/postbuild_scripts.cmake)
+
+if(PROJECT_BUILD_TESTS)
+    include(cmake/utils/tests.cmake)
+endif()
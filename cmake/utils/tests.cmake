@@ -0,0 +1,38 @@
+enable_testing()
+
+set(PROJECT_TESTS_DIR      "${CMAKE_SOURCE_DIR}/tests")
+set(PROJECT_BENCHMARKS_DIR "${CMAKE_SOURCE_DIR}/benchmarks")
+
+file(GLOB PROJECT_TEST_FILES CONFIGURE_DEPENDS
+    "${PROJECT_TESTS_DIR}/*.cpp"
+)
+
+file(GLOB PROJECT_BENCHMARK_FILES CONFIGURE_DEPENDS
+    "${PROJECT_BENCHMARKS_DIR}/*.cpp"
+)
+
+# One executable per source file, run with its own settings directory inside the build tree so it
+# never touches the user's configuration. Extra arguments are passed on to add_test().
+function(add_project_test SOURCE_FILE)
+    get_filename_component(TEST_NAME ${SOURCE_FILE} NAME_WE)
+    set(TEST_HOME "${CMAKE_BINARY_DIR}/tests/${TEST_NAME}")
+
+    add_executable(${TEST_NAME} ${SOURCE_FILE})
+
+    target_include_directories(${TEST_NAME} PRIVATE ${PROJECT_INCLUDE_DIRS} ${PROJECT_TESTS_DIR})
+    target_link_directories(${TEST_NAME}    PRIVATE ${PROJECT_INCLUDE_DIRS})
+    target_link_libraries(${TEST_NAME}      PRIVATE ${PROJECT_LIBRARIES_LIST})
+
+    add_test(NAME ${TEST_NAME} COMMAND ${TEST_NAME} ${ARGN})
+    set_tests_properties(${TEST_NAME} PROPERTIES
+        ENVIRONMENT "HOME=${TEST_HOME};XDG_CONFIG_HOME=${TEST_HOME};PROJECT_TEST_HOME=${TEST_HOME}")
+endfunction()
+
+foreach(TEST_FILE ${PROJECT_TEST_FILES})
+    add_project_test(${TEST_FILE})
+endforeach()
+
+# Benchmarks only run when asked for: ctest -C Benchmark -R benchmark -V
+foreach(BENCHMARK_FILE ${PROJECT_BENCHMARK_FILES})
+    add_project_test(${BENCHMARK_FILE} CONFIGURATIONS Benchmark)
+endforeach()
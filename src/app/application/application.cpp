@@ -1,10 +1,17 @@
 #include "application.hpp"
 
 #include "spdlog_wrapper.hpp"
+#include "terminal_screen.hpp"
+#include "totp_daemon.hpp"
+#include "totp_http_server.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <random>
 #include <sstream>
 #include <thread>
 
@@ -13,6 +20,13 @@
 #else
 #include <termios.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/timerfd.h>
+#endif
 class RawTerminal
 {
 private:
@@ -34,6 +48,83 @@ public:
 		tcsetattr(STDIN_FILENO, TCSANOW, &original_settings);
 	}
 };
+
+#ifdef __linux__
+// Sleeps until the next whole wall-clock second or a key press, whichever comes first. Every TOTP
+// boundary is a whole second, so the same wakeup serves countdowns and exact rollovers.
+// CANCEL_ON_SET wakes it early if the wall clock is changed.
+class TickTimer
+{
+private:
+	int	   timer  = -1;
+	pollfd fds[2] = {};
+
+public:
+	TickTimer()
+	{
+		timer  = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+		fds[0] = {STDIN_FILENO, POLLIN, 0};
+		fds[1] = {timer, POLLIN, 0};
+	}
+
+	~TickTimer()
+	{
+		if (timer >= 0)
+		{
+			close(timer);
+		}
+	}
+
+	bool valid() const
+	{
+		return timer >= 0;
+	}
+
+	// Returns the key pressed, 0 for a plain tick, or -1 if waiting failed.
+	int wait()
+	{
+		timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		itimerspec tick		 = {};
+		tick.it_value.tv_sec = now.tv_sec + 1;
+		timerfd_settime(timer, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &tick, nullptr);
+
+		while (poll(fds, std::size(fds), -1) < 0)
+		{
+			if (errno != EINTR)
+			{
+				return -1;
+			}
+		}
+
+		int key = 0;
+		if (fds[0].revents & (POLLIN | POLLHUP))
+		{
+			char	c	 = 0;
+			ssize_t size = read(STDIN_FILENO, &c, 1);
+			if (size == 1)
+			{
+				key = static_cast<unsigned char>(c);
+			}
+			else if (size == 0)
+			{
+				// Stdin reached end of file; keep ticking without it.
+				fds[0].fd = -1;
+			}
+		}
+
+		if (fds[1].revents & POLLIN)
+		{
+			// Fails with ECANCELED after a clock change, which the caller picks up from the clock.
+			uint64_t				 expirations;
+			[[maybe_unused]] ssize_t size = read(timer, &expirations, sizeof(expirations));
+		}
+
+		return key;
+	}
+};
+#endif
 #endif
 
 namespace APP
@@ -57,12 +148,44 @@ int Application::run()
 		return 0;
 	}
 
+	// Modes that keep running pick up edits to the settings file without a restart.
+	if (m_option_manager->has_option("daemon") || m_option_manager->has_option("http") || m_option_manager->has_option("D")
+		|| m_option_manager->has_option("w"))
+	{
+		m_settings_manager->watch_settings();
+	}
+
+	if (m_option_manager->has_option("daemon"))
+	{
+		return run_daemon();
+	}
+
+	if (m_option_manager->has_option("http"))
+	{
+		return run_http_server();
+	}
+
 	if (m_option_manager->has_option("s"))
 	{
 		handle_set_secret();
 	}
+	else if (m_option_manager->has_option("a"))
+	{
+		if (!m_totp_manager->select_account(m_option_manager->get_option<std::string>("a")))
+		{
+			return 1;
+		}
+	}
 
-	if (m_option_manager->has_option("w"))
+	if (m_option_manager->has_option("l"))
+	{
+		list_accounts();
+	}
+	else if (m_option_manager->has_option("D"))
+	{
+		run_dashboard();
+	}
+	else if (m_option_manager->has_option("w"))
 	{
 		run_watch_mode();
 	}
@@ -74,6 +197,87 @@ int Application::run()
 	return 0;
 }
 
+std::optional<int> Application::run_via_daemon(const int argc, const char** argv)
+{
+	std::vector<std::string_view> arguments(argv + 1, argv + argc);
+
+	std::string request;
+	bool		list = false;
+
+	if (arguments.empty())
+	{
+		request = "GENERATE";
+	}
+	else if (arguments.size() == 1 && (arguments[0] == "-l" || arguments[0] == "--list"))
+	{
+		request = "LIST";
+		list	= true;
+	}
+	else if (arguments.size() == 2 && (arguments[0] == "-a" || arguments[0] == "--account"))
+	{
+		request = fmt::format("GENERATE\t{}", arguments[1]);
+	}
+	else if (arguments.size() == 1 && arguments[0].starts_with("--account="))
+	{
+		request = fmt::format("GENERATE\t{}", arguments[0].substr(std::string_view("--account=").size()));
+	}
+	else
+	{
+		return std::nullopt;
+	}
+
+	UTILS::DaemonClient client;
+	if (!client.connect(TOTPCLIENT::default_socket_path()))
+	{
+		return std::nullopt;
+	}
+
+	// Anything but a clean answer falls back to the full start-up, which reports errors properly.
+	std::optional<std::string> reply = client.request(request);
+	if (!reply || !reply->starts_with("OK\t"))
+	{
+		return std::nullopt;
+	}
+
+	std::string_view fields = std::string_view(*reply).substr(3);
+
+	if (!list)
+	{
+		size_t tab = fields.find('\t');
+		if (tab == std::string_view::npos)
+		{
+			return std::nullopt;
+		}
+
+		std::cout << "Account: " << fields.substr(0, tab) << std::endl;
+		std::cout << "TOTP Code: " << fields.substr(tab + 1) << std::endl;
+		return 0;
+	}
+
+	size_t count = 0;
+	std::from_chars(fields.data(), fields.data() + fields.size(), count);
+	if (count == 0)
+	{
+		return std::nullopt;
+	}
+
+	std::string output;
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::optional<std::string> line = client.read_line();
+		size_t					   tab	= line ? line->find('\t') : std::string::npos;
+		if (tab == std::string::npos)
+		{
+			return std::nullopt;
+		}
+
+		output.append(*line, 0, tab).append(": ").append(*line, tab + 1).push_back('\n');
+	}
+
+	std::cout << output << std::flush;
+	return 0;
+}
+
 bool Application::initialize_managers(const int argc, const char** argv)
 {
 	this->m_option_manager		 = UTILS::OptionManager::instance();
@@ -83,9 +287,14 @@ bool Application::initialize_managers(const int argc, const char** argv)
 
 	this->m_option_manager->add_option("h,help", "Prints this help menu.");
 	this->m_option_manager->add_option("d,debug", "Prints debug info.");
-	this->m_option_manager->add_option<std::string>("a,account", "Account name (used with -s).", "");
+	this->m_option_manager->add_option<std::string>("a,account", "Account name (used with -s, or selects a stored account).", "");
 	this->m_option_manager->add_option<std::string>("s,secret", "Set a new TOTP secret for an account and prints the code.", "");
 	this->m_option_manager->add_option("w,watch", "Watch and continuously update the TOTP code.");
+	this->m_option_manager->add_option("l,list", "Prints the current TOTP code of every stored account.");
+	this->m_option_manager->add_option("D,dashboard", "Shows a live dashboard of every stored account.");
+	this->m_option_manager->add_option("daemon", "Keeps running and serves codes to other invocations over a local socket.");
+	this->m_option_manager->add_option<uint16_t>("http", "Keeps running and serves codes over HTTP on the given port.");
+	this->m_option_manager->add_option<std::string>("http-address", "Address the HTTP server binds to.", std::string(d_http_default_address));
 
 	this->m_option_manager->parse_options(argc, argv);
 
@@ -104,8 +313,8 @@ bool Application::initialize_managers(const int argc, const char** argv)
 	std::tm			   tm		 = *std::localtime(&now_tt);
 	std::ostringstream oss;
 	oss << std::put_time(&tm, "%c %Z");
-	this->m_settings_manager->set_setting("application.last-launch", oss.str());
-	this->m_settings_manager->save_settings();
+	// Not worth a write of its own: it reaches the file with the next change that is saved.
+	this->m_settings_manager->set_setting("application.last-launch", oss.str(), UTILS::SettingPersistence::TRANSIENT);
 
 	return true;
 }
@@ -118,6 +327,8 @@ bool Application::initialize_app()
 void Application::cleanup()
 {
 	this->m_notification_manager->shutdown();
+	this->m_settings_manager->stop_watching();
+	this->m_settings_manager->save_settings();
 	SPD_INFO_CLASS(COMMON::d_settings_group_application, "Application cleaned up");
 }
 
@@ -154,6 +365,8 @@ void Application::run_watch_mode()
 
 	SPD_INFO_CLASS(COMMON::d_settings_group_application, fmt::format("Starting watch mode for account: {}. Press 'q' to quit.", account_name));
 
+	const uint32_t period = m_totp_manager->get_account_parameters().period;
+
 #ifdef _WIN32
 	while (true)
 	{
@@ -167,10 +380,48 @@ void Application::run_watch_mode()
 		}
 
 		std::string code		   = m_totp_manager->generate_totp();
-		int			remaining_time = 30 - (time(NULL) % 30);
+		int			remaining_time = period - (time(NULL) % period);
 		std::cout << "Code: " << code << "  (updates in " << std::setw(2) << remaining_time << "s)  \r" << std::flush;
 		std::this_thread::sleep_for(std::chrono::milliseconds(200));
 	}
+#elif defined(__linux__)
+	RawTerminal raw_term;
+	TickTimer	ticks;
+	if (!ticks.valid())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_application, fmt::format("Failed to create watch timer: {}", strerror(errno)));
+		return;
+	}
+
+	char	 code[UTILS::d_max_code_digits];
+	size_t	 code_size = 0;
+	uint64_t rollover  = 0;
+
+	while (true)
+	{
+		const uint64_t unix_time = static_cast<uint64_t>(time(NULL));
+
+		if (unix_time >= rollover || unix_time + period < rollover)
+		{
+			m_totp_manager->precompute_codes(unix_time);
+			code_size = m_totp_manager->generate_totp(unix_time, code);
+			rollover  = (unix_time / period + 1) * period;
+		}
+
+		std::cout << "Code: " << std::string_view(code, code_size) << "  (updates in " << std::setw(2) << rollover - unix_time << "s)  \r" << std::flush;
+
+		int key = ticks.wait();
+		if (key < 0)
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_application, fmt::format("Watch mode poll failed: {}", strerror(errno)));
+			break;
+		}
+
+		if (key == 'q' || key == 'Q')
+		{
+			break;
+		}
+	}
 #else
 	RawTerminal raw_term;
 	while (true)
@@ -185,7 +436,7 @@ void Application::run_watch_mode()
 		}
 
 		std::string code		   = m_totp_manager->generate_totp();
-		int			remaining_time = 30 - (time(NULL) % 30);
+		int			remaining_time = period - (time(NULL) % period);
 		std::cout << "Code: " << code << "  (updates in " << std::setw(2) << remaining_time << "s)  \r" << std::flush;
 		std::this_thread::sleep_for(std::chrono::milliseconds(200));
 	}
@@ -195,6 +446,181 @@ void Application::run_watch_mode()
 	SPD_INFO_CLASS(COMMON::d_settings_group_application, "Watch mode stopped.");
 }
 
+int Application::run_daemon()
+{
+	UTILS::TOTPDaemon server(m_totp_manager);
+	if (!server.listen(TOTPCLIENT::default_socket_path()))
+	{
+		return 1;
+	}
+	server.publish_codes(TOTPCLIENT::default_code_table_path());
+
+	return server.run() ? 0 : 1;
+}
+
+int Application::run_http_server()
+{
+	const std::string address = m_option_manager->has_option("http-address") ? m_option_manager->get_option<std::string>("http-address")
+																			  : std::string(d_http_default_address);
+
+	// Any local user can reach even a loopback address, so the server always wants a token; make one
+	// on first use, kept in the settings file (mode 0600) next to the secrets it protects.
+	std::string token = m_settings_manager->get_setting<std::string>("http.token", "");
+	if (token.empty())
+	{
+		std::random_device random;
+		for (int i = 0; i < 8; ++i)
+		{
+			token += fmt::format("{:08x}", random());
+		}
+
+		if (!m_settings_manager->set_setting<std::string>("http.token", token) || !m_settings_manager->save_settings())
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_application, "Failed to store a generated HTTP token in the settings.");
+			return 1;
+		}
+
+		SPD_INFO_CLASS(COMMON::d_settings_group_application,
+					   "Generated an HTTP token under [http] token in the settings file; clients send it as 'Authorization: Bearer <token>'.");
+	}
+
+	UTILS::TOTPHttpServer server(m_totp_manager, token);
+	if (!server.listen(address, m_option_manager->get_option<uint16_t>("http")))
+	{
+		return 1;
+	}
+
+	return server.run() ? 0 : 1;
+}
+
+void Application::run_dashboard()
+{
+	struct Row
+	{
+		std::string				 name;
+		UTILS::AccountParameters parameters;
+		uint64_t				 step = UINT64_MAX;
+		char					 code[UTILS::d_max_code_digits] = {};
+		size_t					 code_size						= 0;
+	};
+
+	std::vector<Row> rows;
+	size_t			 name_width = 0;
+	for (std::string& name : m_totp_manager->get_account_names())
+	{
+		if (auto parameters = m_totp_manager->get_account_parameters(name))
+		{
+			name_width = std::max(name_width, name.size());
+			rows.push_back({std::move(name), *parameters});
+		}
+	}
+
+	if (rows.empty())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_application, "No account configured. Please set one using -s <secret> -a <name>");
+		return;
+	}
+
+	name_width = std::min(name_width, d_dashboard_max_name_width);
+
+	UTILS::TerminalScreen screen;
+	size_t				  scroll = 0;
+	std::string			  line;
+
+#ifdef __linux__
+	TickTimer ticks;
+	if (!ticks.valid())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_application, fmt::format("Failed to create dashboard timer: {}", strerror(errno)));
+		return;
+	}
+#endif
+#ifndef _WIN32
+	RawTerminal raw_term;
+#endif
+
+	screen.enter();
+
+	while (true)
+	{
+		const uint64_t unix_time = static_cast<uint64_t>(time(NULL));
+		m_totp_manager->precompute_codes(unix_time);
+
+		auto [height, width] = UTILS::TerminalScreen::terminal_size();
+		screen.resize(height, width);
+		screen.clear();
+
+		const size_t visible = height > 1 ? height - 1 : 0;
+		scroll				 = std::min(scroll, rows.size() > visible ? rows.size() - visible : 0);
+
+		screen.put(0, 0, fmt::format("TOTP accounts {}-{} of {}  (j/k scroll, q quit)", scroll + 1, std::min(scroll + visible, rows.size()), rows.size()));
+
+		for (size_t i = 0; i < visible && scroll + i < rows.size(); ++i)
+		{
+			Row&		   row		 = rows[scroll + i];
+			const uint64_t period	 = row.parameters.period;
+			const uint64_t step		 = unix_time / period;
+			const uint64_t remaining = (step + 1) * period - unix_time;
+
+			// Codes only change at the row's own boundary; everything else is countdown.
+			if (step != row.step)
+			{
+				row.code_size = m_totp_manager->generate_totp(row.name, unix_time, row.code);
+				row.step	  = step;
+			}
+
+			const size_t filled = static_cast<size_t>(remaining * d_dashboard_bar_width / period);
+
+			line.clear();
+			fmt::format_to(std::back_inserter(line),
+						   "{:<{}.{}}  {:<10}  [{:#<{}}{:.<{}}] {:>3}s",
+						   row.name,
+						   name_width,
+						   name_width,
+						   std::string_view(row.code, row.code_size),
+						   "",
+						   filled,
+						   "",
+						   d_dashboard_bar_width - filled,
+						   remaining);
+			screen.put(i + 1, 0, line);
+		}
+
+		screen.present();
+
+		int key = 0;
+#ifdef __linux__
+		key = ticks.wait();
+		if (key < 0)
+		{
+			break;
+		}
+#elif defined(_WIN32)
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		key = _kbhit() ? _getch() : 0;
+#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		char c = 0;
+		key	   = read(STDIN_FILENO, &c, 1) > 0 ? c : 0;
+#endif
+
+		if (key == 'q' || key == 'Q')
+		{
+			break;
+		}
+		else if (key == 'j' && scroll + visible < rows.size())
+		{
+			++scroll;
+		}
+		else if (key == 'k' && scroll > 0)
+		{
+			--scroll;
+		}
+	}
+
+	screen.leave();
+}
+
 void Application::generate_and_print_once()
 {
 	std::string account_name = m_totp_manager->get_account_name();
@@ -216,4 +642,19 @@ void Application::generate_and_print_once()
 	}
 }
 
+void Application::list_accounts()
+{
+	std::vector<std::string> account_names = m_totp_manager->get_account_names();
+	if (account_names.empty())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_application, "No account configured. Please set one using -s <secret> -a <name>");
+		return;
+	}
+
+	for (const auto& account_name : account_names)
+	{
+		std::cout << account_name << ": " << m_totp_manager->generate_totp(account_name) << std::endl;
+	}
+}
+
 } // namespace APP
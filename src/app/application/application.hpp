@@ -7,9 +7,17 @@
 #include "totp_manager.hpp"
 
 #include <memory>
+#include <optional>
+#include <string_view>
 
 namespace APP
 {
+constexpr size_t d_dashboard_bar_width		= 20;
+constexpr size_t d_dashboard_max_name_width = 32;
+
+// Loopback only unless --http-address says otherwise, which also needs http.token in the settings.
+constexpr std::string_view d_http_default_address = "127.0.0.1";
+
 class Application
 {
 public:
@@ -21,6 +29,10 @@ public:
 
 	int run();
 
+	// Answers plain generate and list invocations from a running daemon, before any manager is
+	// started. Returns nullopt when the request needs the full application or no daemon answers.
+	static std::optional<int> run_via_daemon(const int argc, const char** argv);
+
 private:
 	bool initialize_managers(const int argc, const char** argv);
 	bool initialize_app();
@@ -28,7 +40,11 @@ private:
 
 	void handle_set_secret();
 	void run_watch_mode();
+	void run_dashboard();
+	int	 run_daemon();
+	int	 run_http_server();
 	void generate_and_print_once();
+	void list_accounts();
 
 private:
 	std::shared_ptr<UTILS::NotificationManager> m_notification_manager;
@@ -6,6 +6,12 @@ int main(const int argc, const char** argv)
 	spdlog::set_level(spdlog::level::debug);
 #endif
 
+	// Plain lookups are answered by a running daemon without loading settings or starting managers.
+	if (auto status = APP::Application::run_via_daemon(argc, argv))
+	{
+		return *status;
+	}
+
 	auto main_program = APP::Application(argc, argv);
 
 	return main_program.run();
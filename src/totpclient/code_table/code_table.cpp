@@ -0,0 +1,195 @@
+#include "code_table.hpp"
+
+#include "global_names.hpp"
+
+#include <bit>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// A writer that died mid-publish leaves the sequence odd for good; give up rather than spin forever.
+constexpr size_t d_code_table_max_retries = size_t {1} << 20;
+
+// Word-wise relaxed loads: the copy may race with the writer, which the sequence check then catches.
+void copy_entry(const TOTPCLIENT::CodeTableEntry& source, TOTPCLIENT::CodeTableEntry& destination)
+{
+	constexpr size_t d_words = sizeof(TOTPCLIENT::CodeTableEntry) / sizeof(uint64_t);
+
+	uint64_t  words[d_words];
+	uint64_t* shared = const_cast<uint64_t*>(reinterpret_cast<const uint64_t*>(&source));
+	for (size_t i = 0; i < d_words; ++i)
+	{
+		words[i] = std::atomic_ref<uint64_t>(shared[i]).load(std::memory_order_relaxed);
+	}
+
+	std::memcpy(&destination, words, sizeof(words));
+}
+} // namespace
+
+namespace TOTPCLIENT
+{
+
+std::string default_code_table_path()
+{
+	const std::string name = std::string(COMMON::d_project_name) + ".codes";
+
+#ifdef _WIN32
+	return (std::filesystem::temp_directory_path() / name).string();
+#else
+	return "/dev/shm/" + std::string(COMMON::d_project_name) + "-" + std::to_string(getuid()) + ".codes";
+#endif
+}
+
+CodeTableReader::~CodeTableReader()
+{
+	this->close();
+}
+
+bool CodeTableReader::is_open() const
+{
+	return m_header != nullptr;
+}
+
+std::optional<CodeTableEntry> CodeTableReader::find(std::string_view account)
+{
+	if (this->is_open() && m_header->retired.load(std::memory_order_acquire) != 0)
+	{
+		this->close();
+	}
+
+	if (!this->is_open() && !this->open(m_path.empty() ? default_code_table_path() : m_path))
+	{
+		return std::nullopt;
+	}
+
+	const uint64_t mask = m_header->capacity - 1;
+	const uint64_t hash = fnv1a_hash(account);
+
+	for (size_t attempt = 0; attempt < d_code_table_max_retries; ++attempt)
+	{
+		const uint64_t before = m_header->sequence.load(std::memory_order_acquire);
+		if (before & 1)
+		{
+			continue;
+		}
+
+		std::optional<CodeTableEntry> result;
+		for (uint64_t probe = 0; probe <= mask; ++probe)
+		{
+			CodeTableEntry entry;
+			copy_entry(m_entries[(hash + probe) & mask], entry);
+
+			if (entry.account_size == 0)
+			{
+				break;
+			}
+
+			if (entry_account(entry) == account)
+			{
+				result = entry;
+				break;
+			}
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_header->sequence.load(std::memory_order_relaxed) == before)
+		{
+			return result;
+		}
+	}
+
+	return std::nullopt;
+}
+
+size_t CodeTableReader::code(std::string_view account, std::span<char> output, uint64_t unix_time)
+{
+	std::optional<CodeTableEntry> entry = this->find(account);
+	std::optional<uint32_t>		  code	= entry ? entry_code(*entry, unix_time != 0 ? unix_time : static_cast<uint64_t>(time(NULL))) : std::nullopt;
+	if (!code || entry->digits == 0 || output.size() < entry->digits)
+	{
+		return 0;
+	}
+
+	uint32_t value = *code;
+	for (size_t i = entry->digits; i > 0; --i)
+	{
+		output[i - 1] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	}
+
+	return entry->digits;
+}
+
+#ifdef _WIN32
+
+bool CodeTableReader::open(const std::string& path)
+{
+	m_path = path;
+	return false;
+}
+
+void CodeTableReader::close()
+{}
+
+#else
+
+bool CodeTableReader::open(const std::string& path)
+{
+	this->close();
+	m_path = path;
+
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// /dev/shm is shared by every user, so only trust a table this user published.
+	struct stat status = {};
+	const bool	owned  = fstat(fd, &status) == 0 && status.st_uid == getuid() && static_cast<size_t>(status.st_size) >= sizeof(CodeTableHeader);
+	void*		map	   = owned ? mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		return false;
+	}
+
+	const auto*	 header = static_cast<const CodeTableHeader*>(map);
+	const size_t size	= static_cast<size_t>(status.st_size);
+	if (header->magic != d_code_table_magic || header->version != d_code_table_version || !std::has_single_bit(header->capacity)
+		|| sizeof(CodeTableHeader) + size_t {header->capacity} * sizeof(CodeTableEntry) > size)
+	{
+		munmap(map, size);
+		return false;
+	}
+
+	m_header   = header;
+	m_entries  = reinterpret_cast<const CodeTableEntry*>(header + 1);
+	m_map_size = size;
+	return true;
+}
+
+void CodeTableReader::close()
+{
+	if (m_header)
+	{
+		munmap(const_cast<CodeTableHeader*>(m_header), m_map_size);
+		m_header   = nullptr;
+		m_entries  = nullptr;
+		m_map_size = 0;
+	}
+}
+
+#endif
+
+} // namespace TOTPCLIENT
@@ -0,0 +1,117 @@
+#ifndef CODE_TABLE_HPP
+#define CODE_TABLE_HPP
+
+#include "fnv1a.hpp"
+#include "totp_protocol.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace TOTPCLIENT
+{
+// Current codes published by the daemon into a shared-memory file, for consumers too hot for even
+// a socket round trip (PAM modules, prompt widgets).
+//
+// The file is one CodeTableHeader followed by a power-of-two number of CodeTableEntry slots, an
+// open-addressed hash table keyed by account name: an entry lives at the first free slot from
+// fnv1a_hash(account) & (capacity - 1). A single writer guards the table with the header's sequence
+// counter (a seqlock): it is odd while a publish is in progress, and readers retry any copy during
+// which it moved. Each entry carries the code of one step and the next, so a table published
+// shortly before a rollover stays correct across it. When the writer needs a bigger table it
+// renames a new file into place and marks the old one retired; readers then reopen the path.
+constexpr uint32_t d_code_table_magic	= 0x31425443;
+constexpr uint32_t d_code_table_version = 1;
+
+struct CodeTableHeader
+{
+	uint32_t			  magic	   = d_code_table_magic;
+	uint32_t			  version  = d_code_table_version;
+	uint32_t			  capacity = 0; // entry slots, fixed for the file's lifetime
+	std::atomic<uint32_t> retired  = 0;
+
+	alignas(64) std::atomic<uint64_t> sequence = 0;
+	uint64_t						  count		   = 0;
+	uint64_t						  published_at = 0;
+
+	char reserved[40] = {};
+};
+
+struct CodeTableEntry
+{
+	uint64_t valid_from	  = 0; // start of the step `code` belongs to
+	uint32_t period		  = 0;
+	uint32_t code		  = 0;
+	uint32_t next_code	  = 0;
+	uint8_t	 digits		  = 0;
+	uint8_t	 account_size = 0; // 0 marks an empty slot
+	uint16_t reserved	  = 0;
+	char	 account[d_protocol_max_account_size] = {};
+	char	 padding[16]						  = {};
+};
+
+static_assert(sizeof(CodeTableHeader) == 128 && sizeof(CodeTableEntry) == 128);
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+			  "the seqlock must be address-free to work across processes");
+
+constexpr std::string_view entry_account(const CodeTableEntry& entry)
+{
+	return {entry.account, std::min<size_t>(entry.account_size, d_protocol_max_account_size)};
+}
+
+// The code valid at unix_time, or nullopt once the entry is too old to know it.
+constexpr std::optional<uint32_t> entry_code(const CodeTableEntry& entry, uint64_t unix_time)
+{
+	if (entry.period == 0 || unix_time < entry.valid_from)
+	{
+		return std::nullopt;
+	}
+
+	const uint64_t steps = (unix_time - entry.valid_from) / entry.period;
+	if (steps > 1)
+	{
+		return std::nullopt;
+	}
+
+	return steps == 0 ? entry.code : entry.next_code;
+}
+
+// Per-user table: /dev/shm/<project>-<uid>.codes.
+std::string default_code_table_path();
+
+// Maps a published table read-only. Once open, lookups are plain loads: no syscalls, no locks and
+// no allocations, unless the writer retired the table and it has to be reopened.
+class CodeTableReader
+{
+public:
+	CodeTableReader() = default;
+	~CodeTableReader();
+
+	CodeTableReader(const CodeTableReader&)			   = delete;
+	CodeTableReader& operator=(const CodeTableReader&) = delete;
+
+	bool open(const std::string& path = default_code_table_path());
+	void close();
+	bool is_open() const;
+
+	// A consistent copy of the account's entry.
+	std::optional<CodeTableEntry> find(std::string_view account);
+
+	// Writes the zero-padded code valid at unix_time (0 for now) and returns its length, or 0 if the
+	// account is unknown or its entry is stale.
+	size_t code(std::string_view account, std::span<char> output, uint64_t unix_time = 0);
+
+private:
+	const CodeTableHeader* m_header	  = nullptr;
+	const CodeTableEntry*  m_entries  = nullptr;
+	size_t				   m_map_size = 0;
+	std::string			   m_path;
+};
+
+} // namespace TOTPCLIENT
+
+#endif // CODE_TABLE_HPP
@@ -0,0 +1,23 @@
+#ifndef FNV1A_HPP
+#define FNV1A_HPP
+
+#include <cstdint>
+#include <string_view>
+
+namespace TOTPCLIENT
+{
+// 64-bit FNV-1a. Its results are stored on disk (code table slots, vault index slots, the settings
+// cache's source hash), so it must not change without bumping those formats' versions.
+constexpr uint64_t fnv1a_hash(std::string_view data)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : data)
+	{
+		hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+} // namespace TOTPCLIENT
+
+#endif // FNV1A_HPP
@@ -0,0 +1,265 @@
+#include "totp_client.hpp"
+
+#include "global_names.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Generous enough for large batches, short enough that a wedged daemon is noticed.
+constexpr int d_client_timeout_seconds = 5;
+} // namespace
+
+namespace TOTPCLIENT
+{
+
+std::string default_socket_path()
+{
+	const std::string name = std::string(COMMON::d_project_name) + ".sock";
+
+	const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+	if (runtime_dir && *runtime_dir)
+	{
+		return (std::filesystem::path(runtime_dir) / name).string();
+	}
+
+#ifdef _WIN32
+	return (std::filesystem::temp_directory_path() / name).string();
+#else
+	return "/tmp/" + std::string(COMMON::d_project_name) + "-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+Client::~Client()
+{
+	this->disconnect();
+}
+
+bool Client::is_connected() const
+{
+	return m_fd >= 0;
+}
+
+std::optional<ReplyFrame> Client::generate(std::string_view account, uint64_t unix_time)
+{
+	RequestFrame request;
+	ReplyFrame	 reply;
+
+	if (!make_request(request, RequestType::GENERATE, account, {}, 0, unix_time) || !this->transact({&request, 1}, {&reply, 1}))
+	{
+		return std::nullopt;
+	}
+
+	return reply;
+}
+
+std::optional<ReplyFrame> Client::verify(std::string_view account, std::string_view code, uint32_t window)
+{
+	RequestFrame request;
+	ReplyFrame	 reply;
+
+	if (!make_request(request, RequestType::VERIFY, account, code, window) || !this->transact({&request, 1}, {&reply, 1}))
+	{
+		return std::nullopt;
+	}
+
+	return reply;
+}
+
+bool Client::generate_batch(std::span<const std::string_view> accounts, uint64_t unix_time, std::span<ReplyFrame> replies)
+{
+	if (replies.size() < accounts.size())
+	{
+		return false;
+	}
+
+	m_batch.resize(accounts.size());
+	for (size_t i = 0; i < accounts.size(); ++i)
+	{
+		if (!make_request(m_batch[i], RequestType::GENERATE, accounts[i], {}, 0, unix_time))
+		{
+			return false;
+		}
+	}
+
+	return this->transact(m_batch, replies.first(accounts.size()));
+}
+
+bool Client::transact(std::span<RequestFrame> requests, std::span<ReplyFrame> replies)
+{
+	if (requests.size() != replies.size())
+	{
+		return false;
+	}
+
+	if (!this->is_connected() && !this->connect(m_socket_path.empty() ? default_socket_path() : m_socket_path))
+	{
+		return false;
+	}
+
+	const uint32_t first_sequence = m_next_sequence;
+	for (RequestFrame& request : requests)
+	{
+		request.sequence = m_next_sequence++;
+	}
+
+	// A reused connection whose daemon went away fails on the first send; reconnect and retry once.
+	if (!this->send_all(requests.data(), requests.size_bytes()))
+	{
+		this->disconnect();
+		if (!this->connect(m_socket_path) || !this->send_all(requests.data(), requests.size_bytes()))
+		{
+			this->disconnect();
+			return false;
+		}
+	}
+
+	if (!this->receive_all(replies.data(), replies.size_bytes()))
+	{
+		this->disconnect();
+		return false;
+	}
+
+	for (size_t i = 0; i < replies.size(); ++i)
+	{
+		if (replies[i].magic != d_protocol_magic || replies[i].sequence != first_sequence + i)
+		{
+			// Out of step with the daemon; nothing later on this connection can be trusted.
+			this->disconnect();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#ifdef _WIN32
+
+bool Client::connect(const std::string& socket_path)
+{
+	m_socket_path = socket_path;
+	return false;
+}
+
+void Client::disconnect()
+{}
+
+bool Client::send_all(const void*, size_t)
+{
+	return false;
+}
+
+bool Client::receive_all(void*, size_t)
+{
+	return false;
+}
+
+#else
+
+bool Client::connect(const std::string& socket_path)
+{
+	this->disconnect();
+	m_socket_path = socket_path;
+
+	sockaddr_un address = {};
+	address.sun_family	= AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+	socket_path.copy(address.sun_path, socket_path.size());
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	timeval timeout = {d_client_timeout_seconds, 0};
+	setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	bool connected = ::connect(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+#ifdef __linux__
+	// The /tmp fallback path is predictable, so only trust a daemon run by the same user.
+	ucred	  credentials = {};
+	socklen_t length	  = sizeof(credentials);
+	connected			  = connected && getsockopt(m_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == getuid();
+#endif
+
+	if (!connected)
+	{
+		this->disconnect();
+	}
+
+	return connected;
+}
+
+void Client::disconnect()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+bool Client::send_all(const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+
+	while (size > 0)
+	{
+		ssize_t sent = send(m_fd, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+
+	return true;
+}
+
+bool Client::receive_all(void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+
+	while (size > 0)
+	{
+		ssize_t received = recv(m_fd, bytes, size, MSG_WAITALL);
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		bytes += received;
+		size -= static_cast<size_t>(received);
+	}
+
+	return true;
+}
+
+#endif
+
+} // namespace TOTPCLIENT
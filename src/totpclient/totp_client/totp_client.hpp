@@ -0,0 +1,57 @@
+#ifndef TOTP_CLIENT_HPP
+#define TOTP_CLIENT_HPP
+
+#include "totp_protocol.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TOTPCLIENT
+{
+// Reusable connection to the daemon's binary protocol, for services that would otherwise exec the
+// CLI per code.
+//
+// transact() writes a run of request frames in one send and receives the replies directly into
+// the caller's array, so a batch of any size is one round trip. The connection stays open between
+// calls and is re-established once if the daemon restarted since the last one.
+class Client
+{
+public:
+	Client() = default;
+	~Client();
+
+	Client(const Client&)			 = delete;
+	Client& operator=(const Client&) = delete;
+
+	bool connect(const std::string& socket_path = default_socket_path());
+	void disconnect();
+	bool is_connected() const;
+
+	// Numbers the requests and fills replies[i] for requests[i]. Both spans must be the same size.
+	bool transact(std::span<RequestFrame> requests, std::span<ReplyFrame> replies);
+
+	// An empty account asks for the daemon's current account; unix_time 0 uses the daemon's clock.
+	// Codes are always verified against the daemon's clock.
+	std::optional<ReplyFrame> generate(std::string_view account = {}, uint64_t unix_time = 0);
+	std::optional<ReplyFrame> verify(std::string_view account, std::string_view code, uint32_t window = 1);
+
+	// One GENERATE per account, answered in one round trip.
+	bool generate_batch(std::span<const std::string_view> accounts, uint64_t unix_time, std::span<ReplyFrame> replies);
+
+private:
+	bool send_all(const void* data, size_t size);
+	bool receive_all(void* data, size_t size);
+
+	int						  m_fd			  = -1;
+	uint32_t				  m_next_sequence = 1;
+	std::string				  m_socket_path;
+	std::vector<RequestFrame> m_batch;
+};
+
+} // namespace TOTPCLIENT
+
+#endif // TOTP_CLIENT_HPP
@@ -0,0 +1,128 @@
+#ifndef TOTP_PROTOCOL_HPP
+#define TOTP_PROTOCOL_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace TOTPCLIENT
+{
+// Fixed-size binary frames spoken by the daemon next to its text protocol.
+//
+// Every request is one 128-byte RequestFrame and every reply one 32-byte ReplyFrame, answered in
+// request order and tagged with the request's sequence number. Frames are trivially copyable and
+// travel in host byte order (both ends share a machine), so they are sent from and received into
+// caller memory as-is: no parsing, no allocations. Batching is just several frames in one write.
+// The magic's first byte is not ASCII, which lets the daemon tell the protocols apart.
+constexpr uint32_t d_protocol_magic			   = 0x315054B7;
+constexpr uint8_t  d_protocol_version		   = 1;
+constexpr size_t   d_protocol_max_account_size = 88;
+constexpr size_t   d_protocol_max_code_size	   = 16;
+
+enum class RequestType : uint8_t
+{
+	GENERATE = 1,
+	VERIFY	 = 2
+};
+
+enum class ReplyStatus : uint8_t
+{
+	OK				= 0,
+	UNKNOWN_ACCOUNT = 1,
+	REJECTED		= 2,
+	MALFORMED		= 3
+};
+
+struct RequestFrame
+{
+	uint32_t	magic		 = d_protocol_magic;
+	uint8_t		version		 = d_protocol_version;
+	RequestType type		 = RequestType::GENERATE;
+	uint8_t		account_size = 0; // 0 selects the daemon's current account
+	uint8_t		code_size	 = 0;
+	uint32_t	sequence	 = 0;
+	uint32_t	window		 = 0; // VERIFY only
+	uint64_t	unix_time	 = 0; // GENERATE only, 0 uses the daemon's clock
+	char		account[d_protocol_max_account_size] = {};
+	char		code[d_protocol_max_code_size]		 = {};
+};
+
+struct ReplyFrame
+{
+	uint32_t	magic		= d_protocol_magic;
+	uint8_t		version		= d_protocol_version;
+	RequestType type		= RequestType::GENERATE;
+	ReplyStatus status		= ReplyStatus::MALFORMED;
+	uint8_t		digits		= 0;
+	uint32_t	sequence	= 0;
+	uint32_t	code		= 0; // GENERATE: numeric code, see format_code()
+	uint64_t	valid_until = 0; // GENERATE: end of the code's time step
+	int32_t		offset		= 0; // VERIFY: matched step offset
+	uint32_t	reserved	= 0;
+};
+
+static_assert(sizeof(RequestFrame) == 128 && std::is_trivially_copyable_v<RequestFrame>);
+static_assert(sizeof(ReplyFrame) == 32 && std::is_trivially_copyable_v<ReplyFrame>);
+
+// Fills a request; returns false if the account or code does not fit its field.
+constexpr bool make_request(RequestFrame&	 frame,
+							RequestType		 type,
+							std::string_view account,
+							std::string_view code	   = {},
+							uint32_t		 window	   = 0,
+							uint64_t		 unix_time = 0)
+{
+	if (account.size() > d_protocol_max_account_size || code.size() > d_protocol_max_code_size)
+	{
+		return false;
+	}
+
+	frame			   = RequestFrame {};
+	frame.type		   = type;
+	frame.account_size = static_cast<uint8_t>(account.size());
+	frame.code_size	   = static_cast<uint8_t>(code.size());
+	frame.window	   = window;
+	frame.unix_time	   = unix_time;
+	std::copy(account.begin(), account.end(), frame.account);
+	std::copy(code.begin(), code.end(), frame.code);
+
+	return true;
+}
+
+constexpr std::string_view request_account(const RequestFrame& frame)
+{
+	return {frame.account, std::min<size_t>(frame.account_size, d_protocol_max_account_size)};
+}
+
+constexpr std::string_view request_code(const RequestFrame& frame)
+{
+	return {frame.code, std::min<size_t>(frame.code_size, d_protocol_max_code_size)};
+}
+
+// Zero-padded code of a GENERATE reply; returns the characters written, or 0 if it does not fit.
+constexpr size_t format_code(const ReplyFrame& reply, std::span<char> output)
+{
+	if (reply.status != ReplyStatus::OK || reply.digits == 0 || output.size() < reply.digits)
+	{
+		return 0;
+	}
+
+	uint32_t code = reply.code;
+	for (size_t i = reply.digits; i > 0; --i)
+	{
+		output[i - 1] = static_cast<char>('0' + code % 10);
+		code /= 10;
+	}
+
+	return reply.digits;
+}
+
+// Per-user daemon socket: $XDG_RUNTIME_DIR/<project>.sock, or /tmp/<project>-<uid>.sock without it.
+std::string default_socket_path();
+
+} // namespace TOTPCLIENT
+
+#endif // TOTP_PROTOCOL_HPP
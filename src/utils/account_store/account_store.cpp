@@ -0,0 +1,442 @@
+#include "account_store.hpp"
+
+#include "sha_multibuffer.hpp"
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+namespace
+{
+template<typename Pool, typename Hash>
+uint32_t pool_insert(Pool& pool, UTILS::AccountId id, const UTILS::HmacKey<Hash>& key, const UTILS::AccountParameters& parameters)
+{
+	pool.keys.push_back(key);
+	pool.generators.push_back(UTILS::select_totp<Hash>(parameters.period, parameters.digits));
+	pool.owners.push_back(id);
+	return static_cast<uint32_t>(pool.keys.size() - 1);
+}
+
+// Swap-removes a key state and repoints the account that owned the moved entry.
+template<typename Pool>
+void pool_erase(Pool& pool, uint32_t slot, std::vector<uint32_t>& key_slots)
+{
+	uint32_t last = static_cast<uint32_t>(pool.keys.size() - 1);
+
+	if (slot != last)
+	{
+		pool.keys[slot]				 = pool.keys[last];
+		pool.generators[slot]		 = pool.generators[last];
+		pool.owners[slot]			 = pool.owners[last];
+		key_slots[pool.owners[slot]] = slot;
+	}
+
+	pool.keys.pop_back();
+	pool.generators.pop_back();
+	pool.owners.pop_back();
+}
+
+// Walks one key pool in chunks of the widest SIMD batch and scatters the codes back by owner id.
+template<typename Hash, typename Pool>
+void pool_generate(const Pool&					pool,
+				   const std::vector<uint32_t>& periods,
+				   const std::vector<uint32_t>& digits,
+				   uint64_t						unix_time,
+				   int32_t						step_offset,
+				   std::span<uint32_t>			codes)
+{
+	uint64_t chunk_counters[UTILS::d_max_simd_lanes];
+	uint32_t chunk_digits[UTILS::d_max_simd_lanes];
+	uint32_t chunk_codes[UTILS::d_max_simd_lanes];
+
+	for (size_t offset = 0; offset < pool.keys.size(); offset += UTILS::d_max_simd_lanes)
+	{
+		const size_t count = std::min(UTILS::d_max_simd_lanes, pool.keys.size() - offset);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			UTILS::AccountId owner	 = pool.owners[offset + i];
+			int64_t			 counter = static_cast<int64_t>(unix_time / periods[owner]) + step_offset;
+			chunk_counters[i]		 = static_cast<uint64_t>(std::max<int64_t>(counter, 0));
+			chunk_digits[i]			 = digits[owner];
+		}
+
+		if constexpr (std::is_same_v<Hash, UTILS::Sha512>)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				chunk_codes[i] = UTILS::hotp(pool.keys[offset + i], chunk_counters[i], chunk_digits[i]);
+			}
+		}
+		else
+		{
+			UTILS::hotp_batch(std::span(pool.keys).subspan(offset, count),
+							  std::span<const uint64_t>(chunk_counters, count),
+							  std::span<const uint32_t>(chunk_digits, count),
+							  std::span<uint32_t>(chunk_codes, count));
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			UTILS::AccountId owner = pool.owners[offset + i];
+			if (owner < codes.size())
+			{
+				codes[owner] = chunk_codes[i];
+			}
+		}
+	}
+}
+
+// One key over consecutive counters. Multi-buffer lanes take the same key with successive
+// counters; without them the scalar run reuses its padded blocks across codes.
+template<typename Hash>
+void key_range(const UTILS::HmacKey<Hash>& key, uint64_t first_counter, uint32_t digits, std::span<uint32_t> codes)
+{
+	if constexpr (!std::is_same_v<Hash, UTILS::Sha512>)
+	{
+		if (UTILS::simd_level() != UTILS::SimdLevel::SCALAR)
+		{
+			UTILS::HmacKey<Hash> lane_keys[UTILS::d_max_simd_lanes];
+			uint64_t			 lane_counters[UTILS::d_max_simd_lanes];
+			uint32_t			 lane_digits[UTILS::d_max_simd_lanes];
+
+			std::fill(std::begin(lane_keys), std::end(lane_keys), key);
+			std::fill(std::begin(lane_digits), std::end(lane_digits), digits);
+
+			for (size_t offset = 0; offset < codes.size(); offset += UTILS::d_max_simd_lanes)
+			{
+				const size_t count = std::min(UTILS::d_max_simd_lanes, codes.size() - offset);
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					lane_counters[i] = first_counter + offset + i;
+				}
+
+				UTILS::hotp_batch(std::span<const UTILS::HmacKey<Hash>>(lane_keys, count),
+								  std::span<const uint64_t>(lane_counters, count),
+								  std::span<const uint32_t>(lane_digits, count),
+								  codes.subspan(offset, count));
+			}
+			return;
+		}
+	}
+
+	UTILS::hotp_range(key, first_counter, digits, codes);
+}
+} // namespace
+
+namespace UTILS
+{
+
+AccountStore::AccountStore(const AccountStore& other)
+	: m_index(other.m_index)
+	, m_sha1_keys(other.m_sha1_keys)
+	, m_sha256_keys(other.m_sha256_keys)
+	, m_sha512_keys(other.m_sha512_keys)
+	, m_key_slots(other.m_key_slots)
+	, m_periods(other.m_periods)
+	, m_digits(other.m_digits)
+	, m_algorithms(other.m_algorithms)
+	, m_names(other.m_names)
+	, m_secrets(other.m_secrets)
+	, m_serials(other.m_serials)
+	, m_next_serial(other.m_next_serial)
+{
+	// The copied names still point into the other store's index; repoint them at our own keys.
+	for (const auto& [name, id] : m_index)
+	{
+		m_names[id] = name;
+	}
+}
+
+AccountStore& AccountStore::operator=(const AccountStore& other)
+{
+	if (this != &other)
+	{
+		*this = AccountStore(other);
+	}
+
+	return *this;
+}
+
+AccountId AccountStore::add(std::string_view name, std::string_view secret, const AccountParameters& parameters)
+{
+	if (name.empty() || secret.empty())
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils, "Account name and secret cannot be empty.");
+		return d_invalid_account_id;
+	}
+
+	if (parameters.period == 0 || parameters.digits == 0 || parameters.digits > d_max_code_digits)
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils,
+					   fmt::format("Invalid parameters for account '{}': period {}, digits {}.", name, parameters.period, parameters.digits));
+		return d_invalid_account_id;
+	}
+
+	uint8_t				  secret_bytes[d_max_secret_size];
+	std::optional<size_t> secret_size = decode_base32(secret, secret_bytes);
+
+	if (!secret_size || *secret_size == 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to decode TOTP secret for account '{}'.", name));
+		return d_invalid_account_id;
+	}
+
+	AccountId id = this->find(name);
+	if (id == d_invalid_account_id)
+	{
+		id			 = static_cast<AccountId>(m_key_slots.size());
+		auto emplace = m_index.emplace(std::string(name), id);
+
+		m_key_slots.emplace_back();
+		m_periods.emplace_back();
+		m_digits.emplace_back();
+		m_algorithms.emplace_back();
+		m_names.emplace_back(emplace.first->first);
+		m_secrets.emplace_back();
+		m_serials.emplace_back(++m_next_serial);
+	}
+	else
+	{
+		this->erase_key(id);
+	}
+
+	m_algorithms[id] = parameters.algorithm;
+	this->insert_key(id, parameters, {secret_bytes, *secret_size});
+	std::fill(std::begin(secret_bytes), std::end(secret_bytes), 0);
+
+	m_periods[id] = parameters.period;
+	m_digits[id]  = parameters.digits;
+	m_secrets[id] = secret;
+
+	return id;
+}
+
+bool AccountStore::remove(std::string_view name)
+{
+	auto it = m_index.find(name);
+	if (it == m_index.end())
+	{
+		return false;
+	}
+
+	AccountId id   = it->second;
+	AccountId last = static_cast<AccountId>(m_key_slots.size() - 1);
+
+	this->erase_key(id);
+
+	// Keep the arrays dense by moving the last account into the freed slot.
+	if (id != last)
+	{
+		m_key_slots[id]	 = m_key_slots[last];
+		m_periods[id]	 = m_periods[last];
+		m_digits[id]	 = m_digits[last];
+		m_algorithms[id] = m_algorithms[last];
+		m_names[id]		 = m_names[last];
+		m_secrets[id]	 = std::move(m_secrets[last]);
+		m_serials[id]	 = m_serials[last];
+
+		switch (m_algorithms[id])
+		{
+			case TOTPAlgorithm::SHA1:
+				m_sha1_keys.owners[m_key_slots[id]] = id;
+				break;
+			case TOTPAlgorithm::SHA256:
+				m_sha256_keys.owners[m_key_slots[id]] = id;
+				break;
+			case TOTPAlgorithm::SHA512:
+				m_sha512_keys.owners[m_key_slots[id]] = id;
+				break;
+		}
+
+		m_index.find(m_names[id])->second = id;
+	}
+
+	m_key_slots.pop_back();
+	m_periods.pop_back();
+	m_digits.pop_back();
+	m_algorithms.pop_back();
+	m_names.pop_back();
+	m_secrets.pop_back();
+	m_serials.pop_back();
+
+	m_index.erase(it);
+
+	return true;
+}
+
+void AccountStore::clear()
+{
+	m_sha1_keys	  = {};
+	m_sha256_keys = {};
+	m_sha512_keys = {};
+	m_key_slots.clear();
+	m_periods.clear();
+	m_digits.clear();
+	m_algorithms.clear();
+	m_names.clear();
+	m_secrets.clear();
+	m_serials.clear();
+	m_index.clear();
+}
+
+AccountId AccountStore::find(std::string_view name) const
+{
+	auto it = m_index.find(name);
+	return it != m_index.end() ? it->second : d_invalid_account_id;
+}
+
+size_t AccountStore::size() const
+{
+	return m_key_slots.size();
+}
+
+bool AccountStore::empty() const
+{
+	return m_key_slots.empty();
+}
+
+std::string_view AccountStore::get_name(AccountId id) const
+{
+	return m_names[id];
+}
+
+const std::string& AccountStore::get_secret(AccountId id) const
+{
+	return m_secrets[id];
+}
+
+AccountParameters AccountStore::get_parameters(AccountId id) const
+{
+	return {m_periods[id], m_digits[id], m_algorithms[id]};
+}
+
+uint32_t AccountStore::get_serial(AccountId id) const
+{
+	return m_serials[id];
+}
+
+void AccountStore::carry_serials(const AccountStore& previous)
+{
+	m_next_serial = std::max(m_next_serial, previous.m_next_serial);
+
+	for (AccountId id = 0; id < this->size(); ++id)
+	{
+		const AccountId previous_id = previous.find(m_names[id]);
+		m_serials[id]				= previous_id != d_invalid_account_id ? previous.m_serials[previous_id] : ++m_next_serial;
+	}
+}
+
+uint32_t AccountStore::generate(AccountId id, uint64_t unix_time) const
+{
+	const uint32_t slot = m_key_slots[id];
+
+	switch (m_algorithms[id])
+	{
+		case TOTPAlgorithm::SHA1:
+			return m_sha1_keys.generators[slot](m_sha1_keys.keys[slot], unix_time, m_periods[id], m_digits[id]);
+		case TOTPAlgorithm::SHA256:
+			return m_sha256_keys.generators[slot](m_sha256_keys.keys[slot], unix_time, m_periods[id], m_digits[id]);
+		case TOTPAlgorithm::SHA512:
+			return m_sha512_keys.generators[slot](m_sha512_keys.keys[slot], unix_time, m_periods[id], m_digits[id]);
+	}
+
+	return 0;
+}
+
+void AccountStore::generate_all(uint64_t unix_time, std::span<uint32_t> codes, int32_t step_offset) const
+{
+	pool_generate<Sha1>(m_sha1_keys, m_periods, m_digits, unix_time, step_offset, codes);
+	pool_generate<Sha256>(m_sha256_keys, m_periods, m_digits, unix_time, step_offset, codes);
+	pool_generate<Sha512>(m_sha512_keys, m_periods, m_digits, unix_time, step_offset, codes);
+}
+
+size_t AccountStore::generate_range(AccountId id, uint64_t t0, uint64_t t1, std::span<uint32_t> codes) const
+{
+	if (t1 < t0)
+	{
+		return 0;
+	}
+
+	const uint64_t first = t0 / m_periods[id];
+	const size_t   count = static_cast<size_t>(std::min<uint64_t>(t1 / m_periods[id] - first + 1, codes.size()));
+	const uint32_t slot	 = m_key_slots[id];
+
+	switch (m_algorithms[id])
+	{
+		case TOTPAlgorithm::SHA1:
+			key_range(m_sha1_keys.keys[slot], first, m_digits[id], codes.first(count));
+			break;
+		case TOTPAlgorithm::SHA256:
+			key_range(m_sha256_keys.keys[slot], first, m_digits[id], codes.first(count));
+			break;
+		case TOTPAlgorithm::SHA512:
+			key_range(m_sha512_keys.keys[slot], first, m_digits[id], codes.first(count));
+			break;
+	}
+
+	return count;
+}
+
+std::optional<int32_t> AccountStore::verify(AccountId id, uint64_t unix_time, uint32_t code, uint32_t window) const
+{
+	const uint64_t period	  = m_periods[id];
+	const uint64_t counter	  = unix_time / period;
+	const uint64_t step_start = counter * period;
+	const int64_t  max_offset = std::min(window, d_max_verify_window);
+
+	for (int64_t distance = 0; distance <= max_offset; ++distance)
+	{
+		for (int64_t offset : {-distance, distance})
+		{
+			// Skip the duplicate zero offset and steps before the epoch.
+			if ((distance == 0 && offset > 0) || (offset < 0 && static_cast<uint64_t>(-offset) > counter))
+			{
+				continue;
+			}
+
+			if (codes_equal(this->generate(id, step_start + offset * static_cast<int64_t>(period)), code))
+			{
+				return static_cast<int32_t>(offset);
+			}
+		}
+	}
+
+	return std::nullopt;
+}
+
+void AccountStore::insert_key(AccountId id, const AccountParameters& parameters, std::span<const uint8_t> secret)
+{
+	switch (parameters.algorithm)
+	{
+		case TOTPAlgorithm::SHA1:
+			m_key_slots[id] = pool_insert(m_sha1_keys, id, make_hmac_key<Sha1>(secret), parameters);
+			break;
+		case TOTPAlgorithm::SHA256:
+			m_key_slots[id] = pool_insert(m_sha256_keys, id, make_hmac_key<Sha256>(secret), parameters);
+			break;
+		case TOTPAlgorithm::SHA512:
+			m_key_slots[id] = pool_insert(m_sha512_keys, id, make_hmac_key<Sha512>(secret), parameters);
+			break;
+	}
+}
+
+void AccountStore::erase_key(AccountId id)
+{
+	switch (m_algorithms[id])
+	{
+		case TOTPAlgorithm::SHA1:
+			pool_erase(m_sha1_keys, m_key_slots[id], m_key_slots);
+			break;
+		case TOTPAlgorithm::SHA256:
+			pool_erase(m_sha256_keys, m_key_slots[id], m_key_slots);
+			break;
+		case TOTPAlgorithm::SHA512:
+			pool_erase(m_sha512_keys, m_key_slots[id], m_key_slots);
+			break;
+	}
+}
+
+} // namespace UTILS
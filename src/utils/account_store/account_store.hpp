@@ -0,0 +1,120 @@
+#ifndef ACCOUNT_STORE_HPP
+#define ACCOUNT_STORE_HPP
+
+#include "totp_engine.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace UTILS
+{
+using AccountId = uint32_t;
+
+constexpr AccountId d_invalid_account_id = UINT32_MAX;
+
+// Upper bound on the verification drift window, in time steps on each side of the current one.
+constexpr uint32_t d_max_verify_window = 10;
+
+struct AccountParameters
+{
+	uint32_t	  period	= 30;
+	uint32_t	  digits	= 6;
+	TOTPAlgorithm algorithm = TOTPAlgorithm::SHA1;
+};
+
+// Flat struct-of-arrays storage for TOTP accounts. Hot per-code data (period, digits, algorithm)
+// lives in parallel vectors indexed by AccountId, names are interned by the lookup map. Key states
+// are packed in one pool per algorithm so accounts sharing a hash sit contiguously in memory.
+// Ids are dense and stay valid until the next remove() or clear().
+class AccountStore
+{
+public:
+	AccountStore() = default;
+	AccountStore(const AccountStore& other);
+	AccountStore(AccountStore&& other) noexcept = default;
+
+	AccountStore& operator=(const AccountStore& other);
+	AccountStore& operator=(AccountStore&& other) noexcept = default;
+
+	AccountId add(std::string_view name, std::string_view secret, const AccountParameters& parameters);
+	bool	  remove(std::string_view name);
+	void	  clear();
+
+	AccountId find(std::string_view name) const;
+	size_t	  size() const;
+	bool	  empty() const;
+
+	std::string_view  get_name(AccountId id) const;
+	const std::string& get_secret(AccountId id) const;
+	AccountParameters get_parameters(AccountId id) const;
+
+	// Non-zero value that identifies an account for the lifetime of the store. Unlike AccountId it
+	// is not reused when remove() moves another account into the freed slot.
+	uint32_t get_serial(AccountId id) const;
+
+	// For a store rebuilt from scratch: accounts also in previous take over their serial there, and
+	// the others get serials previous never handed out, so serials keep naming the same accounts.
+	void carry_serials(const AccountStore& previous);
+
+	uint32_t generate(AccountId id, uint64_t unix_time) const;
+
+	// Codes for every account at unix_time, shifted by step_offset time steps of each account's own
+	// period (steps before the epoch clamp to step 0). codes[id] receives account id's code.
+	void generate_all(uint64_t unix_time, std::span<uint32_t> codes, int32_t step_offset = 0) const;
+
+	// Codes for account id at every time step from the one containing t0 through the one containing
+	// t1, in order. Writes up to codes.size() of them and returns how many were written.
+	size_t generate_range(AccountId id, uint64_t t0, uint64_t t1, std::span<uint32_t> codes) const;
+
+	// Checks the current step first, then widens outwards (-1, +1, -2, +2, ...) up to window steps,
+	// stopping at the first match. Returns the matched step offset relative to unix_time.
+	std::optional<int32_t> verify(AccountId id, uint64_t unix_time, uint32_t code, uint32_t window) const;
+
+private:
+	template<typename Hash>
+	struct KeyPool
+	{
+		std::vector<HmacKey<Hash>>		keys;
+		std::vector<TotpFunction<Hash>> generators;
+		std::vector<AccountId>			owners;
+	};
+
+	void insert_key(AccountId id, const AccountParameters& parameters, std::span<const uint8_t> secret);
+	void erase_key(AccountId id);
+
+	struct NameHash
+	{
+		using is_transparent = void;
+
+		size_t operator()(std::string_view name) const
+		{
+			return std::hash<std::string_view> {}(name);
+		}
+	};
+
+	std::unordered_map<std::string, AccountId, NameHash, std::equal_to<>> m_index;
+
+	KeyPool<Sha1>	m_sha1_keys;
+	KeyPool<Sha256> m_sha256_keys;
+	KeyPool<Sha512> m_sha512_keys;
+
+	std::vector<uint32_t>		  m_key_slots;
+	std::vector<uint32_t>		  m_periods;
+	std::vector<uint32_t>		  m_digits;
+	std::vector<TOTPAlgorithm>	  m_algorithms;
+	std::vector<std::string_view> m_names;
+	std::vector<std::string>	  m_secrets;
+	std::vector<uint32_t>		  m_serials;
+
+	uint32_t m_next_serial = 0;
+};
+
+} // namespace UTILS
+
+#endif // ACCOUNT_STORE_HPP
@@ -0,0 +1,624 @@
+#include "account_vault.hpp"
+
+#include "fnv1a.hpp"
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <new>
+#include <string>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+uint32_t record_checksum(const char* data, size_t size)
+{
+	uint32_t checksum = 0x811c9dc5u;
+	for (size_t i = 0; i < size; ++i)
+	{
+		checksum = (checksum ^ static_cast<uint8_t>(data[i])) * 0x01000193u;
+	}
+	return checksum;
+}
+
+constexpr uint64_t record_size(size_t name_size, size_t secret_size)
+{
+	return (sizeof(UTILS::VaultRecord) + name_size + secret_size + 7) & ~uint64_t {7};
+}
+} // namespace
+
+namespace UTILS
+{
+
+AccountVault::~AccountVault()
+{
+	this->close();
+}
+
+bool AccountVault::is_open() const
+{
+	return m_index_header != nullptr;
+}
+
+size_t AccountVault::size() const
+{
+	return m_index_header ? m_index_header->count : 0;
+}
+
+std::optional<AccountVault::RecordView> AccountVault::record_at(uint64_t offset) const
+{
+	VaultRecord record;
+	if (offset < sizeof(VaultHeader) || offset > m_log_size || m_log_size - offset < sizeof(record))
+	{
+		return std::nullopt;
+	}
+	std::memcpy(&record, m_log + offset, sizeof(record));
+
+	const uint64_t size = record_size(record.name_size, record.secret_size);
+	if (size > m_log_size - offset || record.name_size == 0 || record.algorithm > static_cast<uint8_t>(TOTPAlgorithm::SHA512))
+	{
+		return std::nullopt;
+	}
+
+	const char* payload = m_log + offset + sizeof(record);
+	if (record.checksum != record_checksum(m_log + offset + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum) + record.name_size + record.secret_size))
+	{
+		return std::nullopt;
+	}
+
+	RecordView view;
+	view.account.name				  = {payload, record.name_size};
+	view.account.secret				  = {payload + record.name_size, record.secret_size};
+	view.account.parameters.period	  = record.period;
+	view.account.parameters.digits	  = record.digits;
+	view.account.parameters.algorithm = static_cast<TOTPAlgorithm>(record.algorithm);
+	view.size						  = size;
+	view.tombstone					  = (record.flags & d_vault_record_tombstone) != 0;
+	return view;
+}
+
+VaultIndexSlot* AccountVault::find_slot(std::string_view name, uint64_t hash) const
+{
+	const uint64_t mask = m_index_header->capacity - 1;
+	for (uint64_t probe = 0; probe <= mask; ++probe)
+	{
+		VaultIndexSlot& slot = m_slots[(hash + probe) & mask];
+		if (slot.offset == 0)
+		{
+			return nullptr;
+		}
+
+		if (slot.offset != d_vault_removed_slot && slot.hash == hash)
+		{
+			std::optional<RecordView> record = this->record_at(slot.offset);
+			if (record && record->account.name == name)
+			{
+				return &slot;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+std::optional<VaultAccount> AccountVault::find(std::string_view name) const
+{
+	if (!this->is_open())
+	{
+		return std::nullopt;
+	}
+
+	const VaultIndexSlot* slot = this->find_slot(name, TOTPCLIENT::fnv1a_hash(name));
+	if (!slot)
+	{
+		return std::nullopt;
+	}
+
+	std::optional<RecordView> record = this->record_at(slot->offset);
+	return record ? std::optional<VaultAccount>(record->account) : std::nullopt;
+}
+
+void AccountVault::for_each(const std::function<void(const VaultAccount&)>& visit) const
+{
+	if (!this->is_open())
+	{
+		return;
+	}
+
+	// Walks the log rather than the index to keep the order stable; a record is live if the index
+	// still points at it.
+	for (uint64_t offset = sizeof(VaultHeader); offset < m_log_size;)
+	{
+		std::optional<RecordView> record = this->record_at(offset);
+		if (!record)
+		{
+			break;
+		}
+
+		if (!record->tombstone)
+		{
+			const VaultIndexSlot* slot = this->find_slot(record->account.name, TOTPCLIENT::fnv1a_hash(record->account.name));
+			if (slot && slot->offset == offset)
+			{
+				visit(record->account);
+			}
+		}
+
+		offset += record->size;
+	}
+}
+
+bool AccountVault::put(std::string_view name, std::string_view secret, const AccountParameters& parameters)
+{
+	std::optional<VaultAccount> current = this->find(name);
+	if (current && current->secret == secret && current->parameters.period == parameters.period
+		&& current->parameters.digits == parameters.digits && current->parameters.algorithm == parameters.algorithm)
+	{
+		return true;
+	}
+
+	return this->append(name, secret, parameters, 0);
+}
+
+bool AccountVault::remove(std::string_view name)
+{
+	if (!this->find(name))
+	{
+		return false;
+	}
+
+	return this->append(name, {}, {}, d_vault_record_tombstone);
+}
+
+void AccountVault::mark_index_unclean()
+{
+	if (m_index_header->clean != 0)
+	{
+		m_index_header->clean = 0;
+#ifndef _WIN32
+		// Durable before any slot changes, so a crash never leaves a half-written index marked clean.
+		msync(m_index_header, sizeof(VaultIndexHeader), MS_SYNC);
+#endif
+	}
+}
+
+void AccountVault::apply(const RecordView& record, uint64_t offset)
+{
+	this->mark_index_unclean();
+
+	const uint64_t	hash = TOTPCLIENT::fnv1a_hash(record.account.name);
+	VaultIndexSlot* slot = this->find_slot(record.account.name, hash);
+
+	if (slot)
+	{
+		std::optional<RecordView> previous = this->record_at(slot->offset);
+		m_index_header->live_bytes -= previous ? previous->size : 0;
+
+		if (record.tombstone)
+		{
+			slot->offset = d_vault_removed_slot;
+			--m_index_header->count;
+		}
+		else
+		{
+			slot->offset = offset;
+			m_index_header->live_bytes += record.size;
+		}
+		return;
+	}
+
+	if (record.tombstone)
+	{
+		return;
+	}
+
+	// Absent: take the first removed or empty slot of the probe sequence.
+	const uint64_t mask = m_index_header->capacity - 1;
+	for (uint64_t probe = 0; probe <= mask; ++probe)
+	{
+		VaultIndexSlot& candidate = m_slots[(hash + probe) & mask];
+		if (candidate.offset == 0 || candidate.offset == d_vault_removed_slot)
+		{
+			m_index_header->used += candidate.offset == 0 ? 1 : 0;
+			candidate.hash	 = hash;
+			candidate.offset = offset;
+			++m_index_header->count;
+			m_index_header->live_bytes += record.size;
+			return;
+		}
+	}
+}
+
+#ifdef _WIN32
+
+bool AccountVault::open(const fs::path& path)
+{
+	m_path = path;
+	SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "Account vaults are not supported on this platform.");
+	return false;
+}
+
+void AccountVault::close()
+{}
+
+bool AccountVault::append(std::string_view, std::string_view, const AccountParameters&, uint8_t)
+{
+	return false;
+}
+
+bool AccountVault::compact()
+{
+	return false;
+}
+
+#else
+
+bool AccountVault::open(const fs::path& path)
+{
+	this->close();
+	m_path = path;
+
+	// Locks the index, which is rewritten in place but never replaced, so the lock holds across
+	// compactions that rename a new log over the old one. The log is opened only once it is held.
+	const fs::path index_path = fs::path(path).concat(".index");
+	m_index_fd				  = ::open(index_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+	int locked = -1;
+	while (m_index_fd >= 0 && (locked = flock(m_index_fd, LOCK_EX)) < 0 && errno == EINTR)
+	{}
+
+	m_log_fd = locked == 0 ? ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600) : -1;
+	if (m_log_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to open account vault '{}': {}", path.string(), strerror(errno)));
+		this->close();
+		return false;
+	}
+
+	struct stat status = {};
+	fstat(m_log_fd, &status);
+	uint64_t log_size = static_cast<uint64_t>(status.st_size);
+
+	if (log_size == 0)
+	{
+		const VaultHeader header;
+		if (pwrite(m_log_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || fdatasync(m_log_fd) < 0)
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create account vault '{}': {}", path.string(), strerror(errno)));
+			this->close();
+			return false;
+		}
+		log_size = sizeof(header);
+	}
+
+	VaultHeader header;
+	if (log_size < sizeof(header) || pread(m_log_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+		|| header.magic != d_vault_magic || header.version != d_vault_version || !this->map_log(log_size))
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("'{}' is not an account vault.", path.string()));
+		this->close();
+		return false;
+	}
+	m_log_size = log_size;
+
+	// Reuse the index if it was closed cleanly and covers no more than the log; only records appended
+	// since need replaying.
+	VaultIndexHeader index_header;
+	fstat(m_index_fd, &status);
+	const bool usable = static_cast<uint64_t>(status.st_size) >= sizeof(index_header)
+					 && pread(m_index_fd, &index_header, sizeof(index_header), 0) == static_cast<ssize_t>(sizeof(index_header))
+					 && index_header.magic == d_vault_index_magic && index_header.version == d_vault_version && index_header.clean != 0
+					 && std::has_single_bit(index_header.capacity) && index_header.log_size >= sizeof(VaultHeader) && index_header.log_size <= m_log_size
+					 && static_cast<uint64_t>(status.st_size) == sizeof(index_header) + index_header.capacity * sizeof(VaultIndexSlot);
+
+	const bool indexed = usable ? this->map_index(index_header.capacity) && this->replay(index_header.log_size)
+								: this->rebuild_index(d_vault_min_index_capacity);
+	if (!indexed)
+	{
+		this->close();
+		return false;
+	}
+
+	return true;
+}
+
+void AccountVault::close()
+{
+	if (m_index_header)
+	{
+		// The slots reach the disk before the flag that vouches for them.
+		if (m_index_header->clean == 0)
+		{
+			msync(m_index_header, m_index_map_size, MS_SYNC);
+			m_index_header->clean = 1;
+		}
+		munmap(m_index_header, m_index_map_size);
+	}
+
+	if (m_log)
+	{
+		munmap(const_cast<char*>(m_log), m_log_map_size);
+	}
+
+	if (m_log_fd >= 0)
+	{
+		::close(m_log_fd);
+	}
+
+	if (m_index_fd >= 0)
+	{
+		::close(m_index_fd);
+	}
+
+	m_log_fd		 = -1;
+	m_index_fd		 = -1;
+	m_log			 = nullptr;
+	m_log_size		 = 0;
+	m_log_map_size	 = 0;
+	m_index_header	 = nullptr;
+	m_slots			 = nullptr;
+	m_index_map_size = 0;
+}
+
+bool AccountVault::map_log(uint64_t size)
+{
+	if (size <= m_log_map_size)
+	{
+		return true;
+	}
+
+	// Mapping past the end of the file is fine as long as nothing reads there.
+	const uint64_t map_size = std::bit_ceil(std::max(size, d_vault_compact_min_bytes));
+	void*		   map		= mmap(nullptr, map_size, PROT_READ, MAP_SHARED, m_log_fd, 0);
+	if (map == MAP_FAILED)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to map account vault '{}': {}", m_path.string(), strerror(errno)));
+		return false;
+	}
+
+	if (m_log)
+	{
+		munmap(const_cast<char*>(m_log), m_log_map_size);
+	}
+
+	m_log		   = static_cast<const char*>(map);
+	m_log_map_size = map_size;
+	return true;
+}
+
+bool AccountVault::map_index(uint64_t capacity)
+{
+	if (m_index_header)
+	{
+		munmap(m_index_header, m_index_map_size);
+		m_index_header = nullptr;
+		m_slots		   = nullptr;
+	}
+
+	const uint64_t size = sizeof(VaultIndexHeader) + capacity * sizeof(VaultIndexSlot);
+	void*		   map	= mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_index_fd, 0);
+	if (map == MAP_FAILED)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to map account vault index: {}", strerror(errno)));
+		return false;
+	}
+
+	m_index_header	 = static_cast<VaultIndexHeader*>(map);
+	m_slots			 = reinterpret_cast<VaultIndexSlot*>(m_index_header + 1);
+	m_index_map_size = size;
+	return true;
+}
+
+bool AccountVault::rebuild_index(uint64_t capacity)
+{
+	const uint64_t size = sizeof(VaultIndexHeader) + capacity * sizeof(VaultIndexSlot);
+	if (ftruncate(m_index_fd, 0) < 0 || ftruncate(m_index_fd, static_cast<off_t>(size)) < 0 || !this->map_index(capacity))
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to rebuild account vault index: {}", strerror(errno)));
+		return false;
+	}
+
+	new (m_index_header) VaultIndexHeader {};
+	m_index_header->capacity = capacity;
+	m_index_header->log_size = sizeof(VaultHeader);
+
+	return this->replay(sizeof(VaultHeader));
+}
+
+bool AccountVault::replay(uint64_t offset)
+{
+	while (offset < m_log_size)
+	{
+		std::optional<RecordView> record = this->record_at(offset);
+		if (!record)
+		{
+			// A crash can only tear the final write. An intact record further on means the damage is
+			// elsewhere, and truncating would throw away every account after it.
+			for (uint64_t next = offset + 8; next < m_log_size; next += 8)
+			{
+				if (this->record_at(next))
+				{
+					SPD_ERROR_CLASS(COMMON::d_settings_group_utils,
+									fmt::format("Account vault '{}' is corrupt at offset {}, with intact records after it; leaving it as is.",
+												m_path.string(),
+												offset));
+					return false;
+				}
+			}
+
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils,
+						   fmt::format("Discarding {} torn bytes at the end of account vault '{}'.", m_log_size - offset, m_path.string()));
+			if (ftruncate(m_log_fd, static_cast<off_t>(offset)) < 0)
+			{
+				return false;
+			}
+			m_log_size = offset;
+			break;
+		}
+
+		// Kept at most half full so probe sequences stay short and always reach an empty slot.
+		if ((m_index_header->used + 1) * 2 > m_index_header->capacity)
+		{
+			return this->rebuild_index(m_index_header->capacity * 2);
+		}
+
+		this->apply(*record, offset);
+		offset += record->size;
+	}
+
+	if (m_index_header->log_size != m_log_size)
+	{
+		this->mark_index_unclean();
+		m_index_header->log_size = m_log_size;
+	}
+	return true;
+}
+
+bool AccountVault::append(std::string_view name, std::string_view secret, const AccountParameters& parameters, uint8_t flags)
+{
+	if (!this->is_open() || name.empty() || name.size() > UINT16_MAX || secret.size() > UINT16_MAX)
+	{
+		return false;
+	}
+
+	VaultRecord record;
+	record.period	   = parameters.period;
+	record.name_size   = static_cast<uint16_t>(name.size());
+	record.secret_size = static_cast<uint16_t>(secret.size());
+	record.flags	   = flags;
+	record.algorithm   = static_cast<uint8_t>(parameters.algorithm);
+	record.digits	   = static_cast<uint8_t>(parameters.digits);
+
+	std::string buffer(record_size(name.size(), secret.size()), '\0');
+	std::memcpy(buffer.data(), &record, sizeof(record));
+	name.copy(buffer.data() + sizeof(record), name.size());
+	secret.copy(buffer.data() + sizeof(record) + name.size(), secret.size());
+
+	record.checksum = record_checksum(buffer.data() + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum) + name.size() + secret.size());
+	std::memcpy(buffer.data(), &record.checksum, sizeof(record.checksum));
+
+	// One data sync per change: the record is durable before the index, which can be rebuilt, points at it.
+	const uint64_t offset  = m_log_size;
+	size_t		   written = 0;
+	while (written < buffer.size())
+	{
+		const ssize_t result = pwrite(m_log_fd, buffer.data() + written, buffer.size() - written, static_cast<off_t>(offset + written));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		written += static_cast<size_t>(result);
+	}
+
+	if (written != buffer.size() || fdatasync(m_log_fd) < 0 || !this->map_log(offset + buffer.size()))
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to write account vault '{}': {}", m_path.string(), strerror(errno)));
+		[[maybe_unused]] int result = ftruncate(m_log_fd, static_cast<off_t>(offset));
+		return false;
+	}
+	m_log_size = offset + buffer.size();
+
+	if (!this->replay(offset))
+	{
+		return false;
+	}
+
+	const uint64_t garbage = m_log_size - sizeof(VaultHeader) - m_index_header->live_bytes;
+	if (garbage > d_vault_compact_min_bytes && garbage > m_index_header->live_bytes)
+	{
+		// The record is already stored; a failed compaction leaves the log as it was.
+		this->compact();
+	}
+
+	return true;
+}
+
+bool AccountVault::compact()
+{
+	if (!this->is_open())
+	{
+		return false;
+	}
+
+	const VaultHeader header;
+	std::string		  buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+	buffer.reserve(sizeof(header) + m_index_header->live_bytes);
+
+	for (uint64_t offset = sizeof(VaultHeader); offset < m_log_size;)
+	{
+		std::optional<RecordView> record = this->record_at(offset);
+		if (!record)
+		{
+			break;
+		}
+
+		const VaultIndexSlot* slot = record->tombstone ? nullptr : this->find_slot(record->account.name, TOTPCLIENT::fnv1a_hash(record->account.name));
+		if (slot && slot->offset == offset)
+		{
+			buffer.append(m_log + offset, record->size);
+		}
+		offset += record->size;
+	}
+
+	// Written beside the log and renamed over it, so a crash leaves one complete log or the other.
+	const fs::path compact_path = fs::path(m_path).concat(".compact");
+	int			   fd			= ::open(compact_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	size_t		   written		= 0;
+	while (fd >= 0 && written < buffer.size())
+	{
+		const ssize_t result = write(fd, buffer.data() + written, buffer.size() - written);
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result <= 0)
+		{
+			break;
+		}
+		written += static_cast<size_t>(result);
+	}
+
+	const bool synced = fd >= 0 && written == buffer.size() && fsync(fd) == 0;
+	if (fd >= 0)
+	{
+		::close(fd);
+	}
+
+	int log_fd = synced && rename(compact_path.c_str(), m_path.c_str()) == 0 ? ::open(m_path.c_str(), O_RDWR | O_CLOEXEC) : -1;
+	if (log_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to compact account vault '{}': {}", m_path.string(), strerror(errno)));
+		unlink(compact_path.c_str());
+		return false;
+	}
+
+	SPD_DEBUG_CLASS(COMMON::d_settings_group_utils,
+					fmt::format("Compacted account vault '{}' from {} to {} bytes.", m_path.string(), m_log_size, buffer.size()));
+
+	munmap(const_cast<char*>(m_log), m_log_map_size);
+	::close(m_log_fd);
+	m_log_fd	   = log_fd;
+	m_log		   = nullptr;
+	m_log_map_size = 0;
+	m_log_size	   = buffer.size();
+
+	const uint64_t capacity = std::bit_ceil(std::max(d_vault_min_index_capacity, m_index_header->count * 4));
+	return this->map_log(m_log_size) && this->rebuild_index(capacity);
+}
+
+#endif
+
+} // namespace UTILS
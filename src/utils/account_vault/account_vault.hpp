@@ -0,0 +1,154 @@
+#ifndef ACCOUNT_VAULT_HPP
+#define ACCOUNT_VAULT_HPP
+
+#include "account_store.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+namespace UTILS
+{
+// Account storage for vaults too large to rewrite on every change.
+//
+// The vault is an append-only log of account records: adding or rotating an account appends its new
+// record, removing one appends a tombstone, and the newest record of a name wins. Each record carries
+// a checksum, so a tail torn by a crash is found and cut off on the next open. Next to the log,
+// "<vault>.index" holds an open-addressed hash table from name to the offset of the live record;
+// lookups read one slot and one record from the mapped files instead of the whole vault. The index
+// is rebuilt from the log whenever it is missing, stale or was not closed cleanly. Once superseded
+// records and tombstones outweigh the live ones, the log is compacted into a fresh file.
+//
+// The index file is locked for as long as the vault is open, so keep it open only for the duration
+// of an operation when several processes share a vault.
+constexpr uint32_t d_vault_magic			  = 0x31564154;
+constexpr uint32_t d_vault_index_magic		  = 0x31495654;
+constexpr uint32_t d_vault_version			  = 1;
+constexpr uint64_t d_vault_min_index_capacity = 64;
+constexpr uint64_t d_vault_compact_min_bytes  = 64 * 1024;
+
+struct VaultHeader
+{
+	uint32_t magic		 = d_vault_magic;
+	uint32_t version	 = d_vault_version;
+	uint64_t reserved[3] = {};
+};
+
+// Followed by the name and the Base32 secret, padded to 8 bytes.
+struct VaultRecord
+{
+	uint32_t checksum	 = 0; // FNV-1a of everything after this field, payload included
+	uint32_t period		 = 0;
+	uint16_t name_size	 = 0;
+	uint16_t secret_size = 0;
+	uint8_t	 flags		 = 0;
+	uint8_t	 algorithm	 = 0;
+	uint8_t	 digits		 = 0;
+	uint8_t	 reserved	 = 0;
+};
+
+constexpr uint8_t d_vault_record_tombstone = 1;
+
+struct VaultIndexHeader
+{
+	uint32_t magic		= d_vault_index_magic;
+	uint32_t version	= d_vault_version;
+	uint64_t capacity	= 0; // slots, a power of two
+	uint64_t count		= 0; // live accounts
+	uint64_t used		= 0; // slots not empty, removed ones included
+	uint64_t log_size	= 0; // log bytes the index reflects
+	uint64_t live_bytes = 0; // log bytes held by live records
+	uint32_t clean		= 0; // set on close; an index left unclean is rebuilt
+	uint32_t reserved	= 0;
+	uint64_t padding	= 0;
+};
+
+struct VaultIndexSlot
+{
+	uint64_t hash	= 0;
+	uint64_t offset = 0; // 0 for an empty slot, d_vault_removed_slot once its account was removed
+};
+
+constexpr uint64_t d_vault_removed_slot = UINT64_MAX;
+
+static_assert(sizeof(VaultHeader) == 32 && sizeof(VaultRecord) == 16);
+static_assert(sizeof(VaultIndexHeader) == 64 && sizeof(VaultIndexSlot) == 16);
+
+// Views into the mapped log, valid until the vault is next written to or closed.
+struct VaultAccount
+{
+	std::string_view  name;
+	std::string_view  secret;
+	AccountParameters parameters;
+};
+
+class AccountVault
+{
+public:
+	AccountVault() = default;
+	~AccountVault();
+
+	AccountVault(const AccountVault&)			 = delete;
+	AccountVault& operator=(const AccountVault&) = delete;
+
+	// Opens or creates the vault, waiting for any other process that has it open.
+	bool open(const fs::path& path);
+	void close();
+	bool is_open() const;
+
+	// Appends the account's new record; the previous one, if any, becomes garbage.
+	bool put(std::string_view name, std::string_view secret, const AccountParameters& parameters);
+
+	// Appends a tombstone. Returns false if the account was not in the vault.
+	bool remove(std::string_view name);
+
+	std::optional<VaultAccount> find(std::string_view name) const;
+	size_t						size() const;
+
+	// Visits every live account in the order it was last written.
+	void for_each(const std::function<void(const VaultAccount&)>& visit) const;
+
+	// Rewrites the log with only its live records.
+	bool compact();
+
+private:
+	struct RecordView
+	{
+		VaultAccount account;
+		uint64_t	 size	   = 0; // bytes in the log, padding included
+		bool		 tombstone = false;
+	};
+
+	std::optional<RecordView> record_at(uint64_t offset) const;
+
+	bool append(std::string_view name, std::string_view secret, const AccountParameters& parameters, uint8_t flags);
+	void mark_index_unclean();
+	bool map_log(uint64_t size);
+	bool map_index(uint64_t capacity);
+	bool rebuild_index(uint64_t capacity);
+	bool replay(uint64_t from);
+	void apply(const RecordView& record, uint64_t offset);
+
+	VaultIndexSlot* find_slot(std::string_view name, uint64_t hash) const;
+
+	fs::path m_path;
+	int		 m_log_fd	= -1;
+	int		 m_index_fd = -1;
+
+	// The log is mapped with room to grow, so most appends do not remap it.
+	const char* m_log		   = nullptr;
+	uint64_t	m_log_size	   = 0;
+	uint64_t	m_log_map_size = 0;
+
+	VaultIndexHeader* m_index_header   = nullptr;
+	VaultIndexSlot*	  m_slots		   = nullptr;
+	uint64_t		  m_index_map_size = 0;
+};
+
+} // namespace UTILS
+
+#endif // ACCOUNT_VAULT_HPP
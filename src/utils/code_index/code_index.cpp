@@ -0,0 +1,156 @@
+#include "code_index.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace
+{
+constexpr size_t d_bloom_bits_per_entry = 16;
+constexpr size_t d_bloom_hash_count		= 3;
+
+// Digits live in the high half, so a valid key is never zero and zero can mark empty slots.
+constexpr uint64_t make_key(uint32_t code, uint32_t digits)
+{
+	return (static_cast<uint64_t>(digits) << 32) | code;
+}
+
+// splitmix64 finalizer.
+constexpr uint64_t mix(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+// Double hashing: the i-th Bloom bit is derived from the two halves of one mixed hash.
+constexpr uint64_t bloom_bit(uint64_t hash, size_t i, size_t mask)
+{
+	return (hash + i * ((hash >> 32) | 1)) & mask;
+}
+} // namespace
+
+namespace UTILS
+{
+
+void CodeIndex::build(const AccountStore& accounts, uint64_t unix_time, uint32_t window)
+{
+	window = std::min(window, d_max_verify_window);
+
+	const size_t count	 = accounts.size();
+	const size_t entries = count * (2 * window + 1);
+
+	m_entries.assign(std::bit_ceil(std::max<size_t>(entries * 2, 16)), Entry {});
+	m_bloom.assign(std::bit_ceil(std::max<size_t>(entries * d_bloom_bits_per_entry, 64)) / 64, 0);
+	m_codes.resize(count);
+
+	m_valid_from  = 0;
+	m_valid_until = std::numeric_limits<uint64_t>::max();
+	m_window	  = window;
+
+	for (AccountId id = 0; id < count; ++id)
+	{
+		uint64_t period		= accounts.get_parameters(id).period;
+		uint64_t step_start = unix_time / period * period;
+
+		m_valid_from  = std::max(m_valid_from, step_start);
+		m_valid_until = std::min(m_valid_until, step_start + period);
+	}
+
+	for (int32_t offset = -static_cast<int32_t>(window); offset <= static_cast<int32_t>(window); ++offset)
+	{
+		accounts.generate_all(unix_time, m_codes, offset);
+
+		for (AccountId id = 0; id < count; ++id)
+		{
+			AccountParameters parameters = accounts.get_parameters(id);
+
+			// generate_all clamps steps before the epoch; those codes were never valid.
+			if (offset < 0 && unix_time / parameters.period < static_cast<uint64_t>(-offset))
+			{
+				continue;
+			}
+
+			this->insert(make_key(m_codes[id], parameters.digits), id, offset);
+		}
+	}
+}
+
+void CodeIndex::invalidate()
+{
+	m_valid_until = 0;
+}
+
+bool CodeIndex::is_current(uint64_t unix_time, uint32_t window) const
+{
+	return m_window == std::min(window, d_max_verify_window) && unix_time >= m_valid_from && unix_time < m_valid_until;
+}
+
+size_t CodeIndex::find(uint32_t code, uint32_t digits, std::span<CodeMatch> matches) const
+{
+	const uint64_t key	= make_key(code, digits);
+	const uint64_t hash = mix(key);
+
+	if (m_entries.empty() || !this->may_contain(hash))
+	{
+		return 0;
+	}
+
+	const size_t mask  = m_entries.size() - 1;
+	size_t		 found = 0;
+
+	for (size_t index = hash & mask; m_entries[index].key != 0; index = (index + 1) & mask)
+	{
+		if (m_entries[index].key != key)
+		{
+			continue;
+		}
+
+		if (found < matches.size())
+		{
+			matches[found] = {m_entries[index].id, m_entries[index].offset};
+		}
+		++found;
+	}
+
+	return found;
+}
+
+void CodeIndex::insert(uint64_t key, AccountId id, int32_t offset)
+{
+	const uint64_t hash = mix(key);
+
+	const size_t bloom_mask = m_bloom.size() * 64 - 1;
+	for (size_t i = 0; i < d_bloom_hash_count; ++i)
+	{
+		uint64_t bit = bloom_bit(hash, i, bloom_mask);
+		m_bloom[bit / 64] |= uint64_t {1} << (bit % 64);
+	}
+
+	// The table is sized for a load factor of at most one half, so a free slot always exists.
+	const size_t mask  = m_entries.size() - 1;
+	size_t		 index = hash & mask;
+	while (m_entries[index].key != 0)
+	{
+		index = (index + 1) & mask;
+	}
+
+	m_entries[index] = {key, id, offset};
+}
+
+bool CodeIndex::may_contain(uint64_t hash) const
+{
+	const size_t bloom_mask = m_bloom.size() * 64 - 1;
+	for (size_t i = 0; i < d_bloom_hash_count; ++i)
+	{
+		uint64_t bit = bloom_bit(hash, i, bloom_mask);
+		if ((m_bloom[bit / 64] & (uint64_t {1} << (bit % 64))) == 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace UTILS
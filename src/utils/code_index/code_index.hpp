@@ -0,0 +1,57 @@
+#ifndef CODE_INDEX_HPP
+#define CODE_INDEX_HPP
+
+#include "account_store.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace UTILS
+{
+struct CodeMatch
+{
+	AccountId id;
+	int32_t	  offset;
+};
+
+// Reverse index from the codes that are currently valid to the accounts that produce them.
+//
+// build() generates every account's codes for the current step and +-window neighbours and stores
+// them in an open-addressing table keyed by (digits, code). Duplicates are allowed, so one code can
+// map to several accounts. A Bloom filter sized at 16 bits per entry sits in front of the table so
+// the common "no such code" answer is settled by three bit tests. The index stays valid until the
+// earliest step rollover among the accounts it was built from.
+class CodeIndex
+{
+public:
+	void build(const AccountStore& accounts, uint64_t unix_time, uint32_t window);
+	void invalidate();
+	bool is_current(uint64_t unix_time, uint32_t window) const;
+
+	// Writes up to matches.size() hits and returns the total number found.
+	size_t find(uint32_t code, uint32_t digits, std::span<CodeMatch> matches) const;
+
+private:
+	struct Entry
+	{
+		uint64_t  key	 = 0;
+		AccountId id	 = d_invalid_account_id;
+		int32_t	  offset = 0;
+	};
+
+	void insert(uint64_t key, AccountId id, int32_t offset);
+	bool may_contain(uint64_t hash) const;
+
+	std::vector<Entry>	  m_entries;
+	std::vector<uint64_t> m_bloom;
+	std::vector<uint32_t> m_codes;
+
+	uint64_t m_valid_from  = 0;
+	uint64_t m_valid_until = 0;
+	uint32_t m_window	   = 0;
+};
+
+} // namespace UTILS
+
+#endif // CODE_INDEX_HPP
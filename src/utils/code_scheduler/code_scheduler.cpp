@@ -0,0 +1,140 @@
+#include "code_scheduler.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace UTILS
+{
+
+CodeCache::CodeCache(const CodeCache&)
+{}
+
+CodeCache& CodeCache::operator=(const CodeCache&)
+{
+	this->reset(0);
+	return *this;
+}
+
+void CodeCache::reset(size_t account_count)
+{
+	m_slots = account_count ? std::make_unique<Slot[]>(account_count) : nullptr;
+	m_size	= account_count;
+	m_pending.store(false, std::memory_order_relaxed);
+}
+
+uint64_t CodeCache::pack(uint64_t step, uint32_t code)
+{
+	// Codes are truncated to 31 bits, so no real word ever equals d_empty_word.
+	return step < d_code_cache_max_step ? step << 32 | code : d_empty_word;
+}
+
+std::optional<uint32_t> CodeCache::lookup(AccountId id, uint64_t step) const
+{
+	if (id >= m_size || step >= d_code_cache_max_step)
+	{
+		return std::nullopt;
+	}
+
+	Slot& slot = m_slots[id];
+
+	const uint64_t current = slot.current.load(std::memory_order_relaxed);
+	if (current >> 32 == step)
+	{
+		return static_cast<uint32_t>(current);
+	}
+
+	const uint64_t next = slot.next.load(std::memory_order_relaxed);
+	if (next >> 32 == step)
+	{
+		return static_cast<uint32_t>(next);
+	}
+
+	// Checked before the exchange so readers of a scheduled account never write the shared line.
+	if (!slot.wanted.load(std::memory_order_relaxed) && !slot.wanted.exchange(true, std::memory_order_relaxed))
+	{
+		m_pending.store(true, std::memory_order_release);
+	}
+
+	return std::nullopt;
+}
+
+void CodeScheduler::reset(size_t account_count)
+{
+	m_scheduled.assign(account_count, false);
+	m_heap.clear();
+}
+
+void CodeScheduler::advance(const AccountStore& accounts, const CodeCache& cache, uint64_t unix_time)
+{
+	const size_t count = std::min(cache.m_size, m_scheduled.size());
+
+	if (cache.m_pending.exchange(false, std::memory_order_acquire))
+	{
+		for (AccountId id = 0; id < count; ++id)
+		{
+			if (m_scheduled[id] || !cache.m_slots[id].wanted.load(std::memory_order_relaxed))
+			{
+				continue;
+			}
+
+			const uint64_t period = accounts.get_parameters(id).period;
+			const uint64_t step	  = unix_time / period;
+
+			this->fill(accounts, cache, id, step);
+			m_scheduled[id] = true;
+
+			m_heap.emplace_back((step + 1) * period, id);
+			std::push_heap(m_heap.begin(), m_heap.end(), std::greater<> {});
+		}
+	}
+
+	while (!m_heap.empty() && m_heap.front().first <= unix_time)
+	{
+		std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<> {});
+		AccountId id = m_heap.back().second;
+
+		CodeCache::Slot& slot	= cache.m_slots[id];
+		const uint64_t	 period = accounts.get_parameters(id).period;
+		const uint64_t	 step	= unix_time / period;
+		const uint64_t	 next	= slot.next.load(std::memory_order_relaxed);
+
+		if (next != CodeCache::d_empty_word && next >> 32 == step)
+		{
+			// The boundary we were waiting for: the precomputed code becomes current.
+			slot.current.store(next, std::memory_order_relaxed);
+			slot.next.store(CodeCache::pack(step + 1, accounts.generate(id, (step + 1) * period)), std::memory_order_relaxed);
+		}
+		else
+		{
+			// Slept through more than one step; start over from unix_time.
+			this->fill(accounts, cache, id, step);
+		}
+
+		m_heap.back().first = (step + 1) * period;
+		std::push_heap(m_heap.begin(), m_heap.end(), std::greater<> {});
+	}
+}
+
+std::optional<uint64_t> CodeScheduler::next_rollover() const
+{
+	if (m_heap.empty())
+	{
+		return std::nullopt;
+	}
+
+	return m_heap.front().first;
+}
+
+void CodeScheduler::fill(const AccountStore& accounts, const CodeCache& cache, AccountId id, uint64_t step)
+{
+	const uint64_t period = accounts.get_parameters(id).period;
+
+	uint32_t codes[2];
+	accounts.generate_range(id, step * period, (step + 1) * period, codes);
+
+	CodeCache::Slot& slot = cache.m_slots[id];
+	slot.current.store(CodeCache::pack(step, codes[0]), std::memory_order_relaxed);
+	slot.next.store(CodeCache::pack(step + 1, codes[1]), std::memory_order_relaxed);
+}
+
+} // namespace UTILS
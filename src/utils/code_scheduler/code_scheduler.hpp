@@ -0,0 +1,89 @@
+#ifndef CODE_SCHEDULER_HPP
+#define CODE_SCHEDULER_HPP
+
+#include "account_store.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace UTILS
+{
+// Steps at or past this bound are never cached, so the 32-bit step tags below are exact.
+constexpr uint64_t d_code_cache_max_step = UINT32_MAX;
+
+// Per-account codes for the current and next time step, read without locks.
+//
+// Each slot holds two words packing a step tag with the code for that step. A word is written and
+// read as one atomic, so a reader either finds the code for its step or misses, never a torn pair,
+// and misses are answered by computing the code directly. Ids refer to the store the cache was last
+// reset() against; the cache is meant to live beside that store in one AccountSnapshot, and copies
+// start empty.
+class CodeCache
+{
+public:
+	CodeCache() = default;
+	CodeCache(const CodeCache&);
+	CodeCache& operator=(const CodeCache&);
+
+	void reset(size_t account_count);
+
+	// The cached code for account id at time step `step`. A miss flags the account so the next
+	// CodeScheduler::advance() starts caching it.
+	std::optional<uint32_t> lookup(AccountId id, uint64_t step) const;
+
+private:
+	friend class CodeScheduler;
+
+	static constexpr uint64_t d_empty_word = UINT64_MAX;
+
+	// Written by the scheduler while the snapshot is shared, hence atomics behind a const cache.
+	struct Slot
+	{
+		std::atomic<uint64_t> current {d_empty_word};
+		std::atomic<uint64_t> next {d_empty_word};
+		std::atomic<bool>	  wanted {false};
+	};
+
+	static uint64_t pack(uint64_t step, uint32_t code);
+
+	std::unique_ptr<Slot[]>	  m_slots;
+	size_t					  m_size	= 0;
+	mutable std::atomic<bool> m_pending = false;
+};
+
+// Keeps a CodeCache current, driven by a min-heap of rollover times.
+//
+// An account joins the schedule at the first advance() after a lookup missed it: its current and
+// next step codes are generated and its next rollover is pushed on the heap. advance() pops every
+// account whose step has ended, promotes the precomputed next code to current and generates the one
+// after it, so each scheduled account costs one HMAC per period no matter how often it is read.
+// Periods may differ per account; the heap always surfaces the earliest boundary. Only advance()
+// moves the schedule, so callers drive it from the wall clock.
+class CodeScheduler
+{
+public:
+	void reset(size_t account_count);
+
+	// Schedules the accounts lookups asked for, then rolls every account whose step ended at or
+	// before unix_time forward to the step containing it.
+	void advance(const AccountStore& accounts, const CodeCache& cache, uint64_t unix_time);
+
+	// Earliest upcoming step boundary among scheduled accounts, if any are scheduled.
+	std::optional<uint64_t> next_rollover() const;
+
+private:
+	using Rollover = std::pair<uint64_t, AccountId>;
+
+	void fill(const AccountStore& accounts, const CodeCache& cache, AccountId id, uint64_t step);
+
+	std::vector<bool>	  m_scheduled;
+	std::vector<Rollover> m_heap;
+};
+
+} // namespace UTILS
+
+#endif // CODE_SCHEDULER_HPP
@@ -0,0 +1,232 @@
+#include "code_table_publisher.hpp"
+
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifndef _WIN32
+// Maps an existing table read-write so its readers can be told to move on; nullptr if there is none.
+TOTPCLIENT::CodeTableHeader* map_existing_table(const fs::path& path, size_t& size)
+{
+	int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat status = {};
+	const bool	owned  = fstat(fd, &status) == 0 && status.st_uid == getuid() && static_cast<size_t>(status.st_size) >= sizeof(TOTPCLIENT::CodeTableHeader);
+	void*		map	   = owned ? mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	if (map == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	auto* header = static_cast<TOTPCLIENT::CodeTableHeader*>(map);
+	size		 = static_cast<size_t>(status.st_size);
+	if (header->magic != TOTPCLIENT::d_code_table_magic)
+	{
+		munmap(map, size);
+		return nullptr;
+	}
+
+	return header;
+}
+#endif
+} // namespace
+
+namespace UTILS
+{
+
+CodeTablePublisher::~CodeTablePublisher()
+{
+	this->close();
+}
+
+bool CodeTablePublisher::open(const fs::path& path)
+{
+	this->close();
+	m_path = path;
+
+	m_staging.assign(d_code_table_min_capacity, TOTPCLIENT::CodeTableEntry {});
+	return this->create(0, 0);
+}
+
+bool CodeTablePublisher::publish(const TOTPManager& totp_manager, uint64_t unix_time)
+{
+	if (!m_header)
+	{
+		return false;
+	}
+
+	const std::vector<std::string> names	= totp_manager.get_account_names();
+	const size_t				   capacity = std::max<size_t>(std::bit_ceil(std::max(names.size() * 2, d_code_table_min_capacity)), m_header->capacity);
+
+	const size_t mask = capacity - 1;
+	m_staging.assign(capacity, TOTPCLIENT::CodeTableEntry {});
+
+	uint64_t count = 0;
+	for (const std::string& name : names)
+	{
+		std::optional<AccountParameters> parameters = totp_manager.get_account_parameters(name);
+		if (!parameters || name.empty() || name.size() > TOTPCLIENT::d_protocol_max_account_size)
+		{
+			continue;
+		}
+
+		// Straight from the engine, so publishing never touches the code cache or its schedule.
+		const uint64_t valid_from = unix_time - unix_time % parameters->period;
+		uint32_t	   codes[2];
+		if (totp_manager.generate_range(name, valid_from, valid_from + parameters->period, codes) != 2)
+		{
+			continue;
+		}
+
+		size_t slot = TOTPCLIENT::fnv1a_hash(name) & mask;
+		while (m_staging[slot].account_size != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		TOTPCLIENT::CodeTableEntry& entry = m_staging[slot];
+		entry.valid_from				  = valid_from;
+		entry.period					  = parameters->period;
+		entry.code						  = codes[0];
+		entry.next_code					  = codes[1];
+		entry.digits					  = static_cast<uint8_t>(parameters->digits);
+		entry.account_size				  = static_cast<uint8_t>(name.size());
+		name.copy(entry.account, name.size());
+		++count;
+	}
+
+	// A bigger table is filled before it replaces this one, so readers never open it empty.
+	if (capacity > m_header->capacity)
+	{
+		return this->create(count, unix_time);
+	}
+
+	// Seqlock write section: odd sequence, the copy, then even again.
+	const uint64_t sequence = m_header->sequence.load(std::memory_order_relaxed);
+	m_header->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(static_cast<void*>(m_entries), m_staging.data(), m_staging.size() * sizeof(TOTPCLIENT::CodeTableEntry));
+	m_header->count		   = count;
+	m_header->published_at = unix_time;
+
+	m_header->sequence.store(sequence + 2, std::memory_order_release);
+	return true;
+}
+
+#ifdef _WIN32
+
+void CodeTablePublisher::close()
+{}
+
+bool CodeTablePublisher::create(uint64_t, uint64_t)
+{
+	SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "Publishing codes to shared memory is not supported on this platform.");
+	return false;
+}
+
+#else
+
+void CodeTablePublisher::close()
+{
+	if (!m_header)
+	{
+		return;
+	}
+
+	m_header->retired.store(1, std::memory_order_release);
+	munmap(m_header, m_map_size);
+	unlink(m_path.c_str());
+
+	m_header   = nullptr;
+	m_entries  = nullptr;
+	m_map_size = 0;
+}
+
+bool CodeTablePublisher::create(uint64_t count, uint64_t published_at)
+{
+	const size_t   capacity		= m_staging.size();
+	const size_t   size			= sizeof(TOTPCLIENT::CodeTableHeader) + capacity * sizeof(TOTPCLIENT::CodeTableEntry);
+	const fs::path staging_path = fs::path(m_path).concat(".tmp");
+
+	// Built under a temporary name and renamed into place, so readers only ever open complete tables.
+	// /dev/shm is world-writable: never follow or reuse a file someone else placed at that name.
+	unlink(staging_path.c_str());
+	int fd = ::open(staging_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create code table '{}': {}", staging_path.string(), strerror(errno)));
+		if (fd >= 0)
+		{
+			::close(fd);
+			unlink(staging_path.c_str());
+		}
+		return false;
+	}
+
+	void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to map code table '{}': {}", staging_path.string(), strerror(errno)));
+		unlink(staging_path.c_str());
+		return false;
+	}
+
+	auto* header		 = new (map) TOTPCLIENT::CodeTableHeader {};
+	header->capacity	 = static_cast<uint32_t>(capacity);
+	header->count		 = count;
+	header->published_at = published_at;
+	std::memcpy(static_cast<void*>(header + 1), m_staging.data(), capacity * sizeof(TOTPCLIENT::CodeTableEntry));
+
+	// The table being replaced is ours, or one left by a writer that crashed; either way its readers
+	// still map it and must be told to reopen the path.
+	size_t						 previous_size = m_map_size;
+	TOTPCLIENT::CodeTableHeader* previous	   = m_header ? m_header : map_existing_table(m_path, previous_size);
+
+	if (rename(staging_path.c_str(), m_path.c_str()) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to publish code table '{}': {}", m_path.string(), strerror(errno)));
+		munmap(map, size);
+		unlink(staging_path.c_str());
+		if (previous && previous != m_header)
+		{
+			munmap(previous, previous_size);
+		}
+		return false;
+	}
+
+	if (previous)
+	{
+		previous->retired.store(1, std::memory_order_release);
+		munmap(previous, previous_size);
+	}
+
+	m_header   = header;
+	m_entries  = reinterpret_cast<TOTPCLIENT::CodeTableEntry*>(header + 1);
+	m_map_size = size;
+	return true;
+}
+
+#endif
+
+} // namespace UTILS
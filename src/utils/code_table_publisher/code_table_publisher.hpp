@@ -0,0 +1,52 @@
+#ifndef CODE_TABLE_PUBLISHER_HPP
+#define CODE_TABLE_PUBLISHER_HPP
+
+#include "code_table.hpp"
+#include "totp_manager.hpp"
+
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace UTILS
+{
+// Smallest table created; it doubles whenever accounts would fill more than half of it.
+constexpr size_t d_code_table_min_capacity = 64;
+
+// Single writer of a TOTPCLIENT code table (see code_table.hpp).
+//
+// Each publish fills a private staging copy, then copies it into the mapping inside one seqlock
+// write section, so readers never wait on anything slower than a memcpy.
+class CodeTablePublisher
+{
+public:
+	CodeTablePublisher() = default;
+	~CodeTablePublisher();
+
+	CodeTablePublisher(const CodeTablePublisher&)			 = delete;
+	CodeTablePublisher& operator=(const CodeTablePublisher&) = delete;
+
+	// Creates the table, retiring one left behind by a previous writer.
+	bool open(const fs::path& path);
+
+	// Retires and removes the table.
+	void close();
+
+	// Publishes the code of every account for the step containing unix_time, and the one after it.
+	bool publish(const TOTPManager& totp_manager, uint64_t unix_time);
+
+private:
+	// Replaces the table with a new one holding m_staging, sized to it.
+	bool create(uint64_t count, uint64_t published_at);
+
+	fs::path								m_path;
+	TOTPCLIENT::CodeTableHeader*			m_header   = nullptr;
+	TOTPCLIENT::CodeTableEntry*				m_entries  = nullptr;
+	size_t									m_map_size = 0;
+	std::vector<TOTPCLIENT::CodeTableEntry> m_staging;
+};
+
+} // namespace UTILS
+
+#endif // CODE_TABLE_PUBLISHER_HPP
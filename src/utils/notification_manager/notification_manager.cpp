@@ -1,7 +1,6 @@
 #include "notification_manager.hpp"
 
 #include "network_manager.hpp"
-#include "settings_manager.hpp"
 
 namespace UTILS
 {
@@ -13,7 +12,14 @@ std::string_view NotificationManager::get_manager_name() const
 }
 
 void NotificationManager::initialize()
-{}
+{
+	auto settings_manager = UTILS::SettingsManager::instance();
+
+	m_enabled_setting  = settings_manager->get_handle<std::string>("notifications.enabled", "false");
+	m_uri_setting	   = settings_manager->get_handle<std::string>("notifications.uri", "");
+	m_username_setting = settings_manager->get_handle<std::string>("notifications.username", "");
+	m_password_setting = settings_manager->get_handle<std::string>("notifications.password", "");
+}
 
 NotificationManager::~NotificationManager()
 {
@@ -53,21 +59,24 @@ void NotificationManager::send_notification(const NotificationMessage& notificat
 {
 	std::lock_guard<std::mutex> lock(this->m_notification_mutex);
 
-	m_futures.push_back(std::async(std::launch::async, [notification] {
-		auto settings_manager = UTILS::SettingsManager::instance();
-		if (settings_manager->get_setting<std::string>("notifications.enabled", "false").compare("false"))
-		{
-			SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, "Unable to send notification, notifications are disabled.");
-			return;
-		}
+	if (m_enabled_setting.get().compare("false"))
+	{
+		SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, "Unable to send notification, notifications are disabled.");
+		return;
+	}
 
-		auto notifications_uri = settings_manager->get_setting<std::string>("notifications.uri", "");
-		if (notifications_uri.empty())
-		{
-			SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, "Unable to send notification, notifications server is empty.");
-			return;
-		}
+	const std::string& notifications_uri = m_uri_setting.get();
+	if (notifications_uri.empty())
+	{
+		SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, "Unable to send notification, notifications server is empty.");
+		return;
+	}
 
+	m_futures.push_back(std::async(std::launch::async,
+								   [notification,
+									notifications_uri,
+									username = m_username_setting.get(),
+									password = m_password_setting.get()] {
 		auto network_manager = UTILS::NetworkManager::instance();
 
 		std::string tags;
@@ -107,8 +116,8 @@ void NotificationManager::send_notification(const NotificationMessage& notificat
 		request.headers = headers;
 		request.body	= notification.message;
 
-		request.username = settings_manager->get_setting<std::string>("notifications.username", "");
-		request.password = settings_manager->get_setting<std::string>("notifications.password", "");
+		request.username = username;
+		request.password = password;
 
 		auto response = network_manager->make_request(request);
 		if (!response.error.empty())
@@ -2,6 +2,7 @@
 #define NOTIFICATION_MANAGER_HPP
 
 #include "manager_singleton.hpp"
+#include "settings_manager.hpp"
 
 #include <future>
 #include <string>
@@ -56,6 +57,13 @@ public:
 						   std::string_view				   schedule		   = "");
 	void send_notification(const NotificationMessage& notification);
 
+private:
+	// Read under m_notification_mutex, so one set of handles serves every sender.
+	SettingHandle<std::string> m_enabled_setting;
+	SettingHandle<std::string> m_uri_setting;
+	SettingHandle<std::string> m_username_setting;
+	SettingHandle<std::string> m_password_setting;
+
 protected:
 	static std::mutex			   m_notification_mutex;
 	std::vector<std::future<void>> m_futures;
@@ -1,6 +1,8 @@
 #include "option_manager.hpp"
 
 #include "settings_manager.hpp"
+#include "sha.hpp"
+#include "sha_multibuffer.hpp"
 #include "spdlog_wrapper.hpp"
 
 namespace UTILS
@@ -138,6 +140,12 @@ void OptionManager::debug_log() const
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, fmt::format("\tCompile Time: {}", COMMON::d_compile_time));
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, fmt::format("\tCompiler:     {:<24} {}", COMMON::d_compiler_id, COMMON::d_compiler_version));
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, "===========================================================");
+	SPD_INFO_CLASS(COMMON::d_settings_group_options, "\tTOTP Engine");
+	SPD_INFO_CLASS(COMMON::d_settings_group_options, "-----------------------------------------------------------");
+	SPD_INFO_CLASS(COMMON::d_settings_group_options,
+				   fmt::format("\tSHA-1/SHA-256: {}", UTILS::sha_implementation_to_string(UTILS::sha_implementation())));
+	SPD_INFO_CLASS(COMMON::d_settings_group_options, fmt::format("\tBatch SIMD:    {}", UTILS::simd_level_to_string(UTILS::simd_level())));
+	SPD_INFO_CLASS(COMMON::d_settings_group_options, "===========================================================");
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, "\tCommand-Line Arguments");
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, "-----------------------------------------------------------");
 	SPD_INFO_CLASS(COMMON::d_settings_group_options, fmt::format("\tArgument Count: {}", arguments.size()));
@@ -0,0 +1,196 @@
+#include "replay_cache.hpp"
+
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+constexpr uint64_t make_entry(uint32_t account_serial, uint64_t counter)
+{
+	return (counter << 32) | account_serial;
+}
+
+constexpr uint32_t entry_step(uint64_t entry)
+{
+	return static_cast<uint32_t>(entry >> 32);
+}
+
+// Spreads sequential serials across the bucket (Fibonacci hashing).
+constexpr size_t probe_start(uint32_t account_serial, size_t mask)
+{
+	return static_cast<size_t>((account_serial * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+} // namespace
+
+namespace UTILS
+{
+
+ReplayCache::ReplayCache(size_t capacity_per_step)
+	: m_capacity(std::bit_ceil(std::max<size_t>(capacity_per_step, 16)))
+{
+}
+
+ReplayCache::SpillTable::SpillTable(size_t capacity)
+	: capacity(capacity)
+	, slots(new std::atomic<uint64_t>[capacity]())
+{
+}
+
+ReplayCache::~ReplayCache()
+{
+	for (PeriodRing& ring : m_rings)
+	{
+		delete[] ring.slots.load(std::memory_order_acquire);
+
+		for (std::atomic<SpillTable*>& spill : ring.spill)
+		{
+			for (SpillTable* table = spill.load(std::memory_order_acquire); table;)
+			{
+				SpillTable* next = table->next.load(std::memory_order_acquire);
+				delete table;
+				table = next;
+			}
+		}
+	}
+}
+
+ReplayCache::PeriodRing* ReplayCache::ring_for(uint32_t period)
+{
+	for (PeriodRing& ring : m_rings)
+	{
+		uint32_t owner = ring.period.load(std::memory_order_acquire);
+
+		if (owner == 0 && ring.period.compare_exchange_strong(owner, period, std::memory_order_acq_rel))
+		{
+			owner = period;
+		}
+
+		if (owner != period)
+		{
+			continue;
+		}
+
+		std::atomic<uint64_t>* slots = ring.slots.load(std::memory_order_acquire);
+		if (slots)
+		{
+			return &ring;
+		}
+
+		// Racing allocators publish with a CAS; the loser frees its copy and uses the winner's.
+		std::atomic<uint64_t>* fresh = new std::atomic<uint64_t>[d_replay_ring_size * m_capacity]();
+		if (!ring.slots.compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+		{
+			delete[] fresh;
+		}
+
+		return &ring;
+	}
+
+	return nullptr;
+}
+
+int ReplayCache::insert(std::atomic<uint64_t>* slots, size_t capacity, uint32_t account_serial, uint64_t entry)
+{
+	const size_t   mask	 = capacity - 1;
+	const uint32_t step	 = entry_step(entry);
+	const size_t   reach = std::min(capacity, d_replay_max_probes);
+
+	// Current-step entries are never removed, so the first stale or empty slot on the probe path marks
+	// the end of this step's chain; anything past it belongs to nobody. Every insert of an entry walks
+	// the same path, so a duplicate always meets the first copy before finding a free slot.
+	for (size_t probe = 0, index = probe_start(account_serial, mask); probe < reach; ++probe, index = (index + 1) & mask)
+	{
+		uint64_t current = slots[index].load(std::memory_order_acquire);
+
+		while (current == 0 || entry_step(current) != step)
+		{
+			if (slots[index].compare_exchange_weak(current, entry, std::memory_order_acq_rel))
+			{
+				return 1;
+			}
+		}
+
+		if (current == entry)
+		{
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+bool ReplayCache::accept(uint32_t account_serial, uint32_t period, uint64_t counter)
+{
+	PeriodRing* ring = this->ring_for(period);
+	if (!ring)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Replay cache has no room for period {}s, rejecting code.", period));
+		return false;
+	}
+
+	const size_t   index = counter % d_replay_ring_size;
+	const uint64_t entry = make_entry(account_serial, counter);
+
+	int result = insert(ring->slots.load(std::memory_order_acquire) + index * m_capacity, m_capacity, account_serial, entry);
+
+	// A busy step goes on to the bucket's larger tables, walked in the same order by every insert.
+	std::atomic<SpillTable*>* link	   = &ring->spill[index];
+	size_t					  capacity = m_capacity;
+	for (size_t tables = 1; result < 0 && tables < d_replay_max_tables; ++tables)
+	{
+		capacity *= 2;
+
+		SpillTable* table = link->load(std::memory_order_acquire);
+		if (!table)
+		{
+			// Racing allocators publish with a CAS; the loser frees its copy and uses the winner's.
+			auto fresh = std::make_unique<SpillTable>(capacity);
+			if (link->compare_exchange_strong(table, fresh.get(), std::memory_order_acq_rel))
+			{
+				table = fresh.release();
+			}
+		}
+
+		result = insert(table->slots.get(), table->capacity, account_serial, entry);
+		link   = &table->next;
+	}
+
+	if (result < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Replay cache bucket for period {}s is full, rejecting code.", period));
+	}
+
+	return result > 0;
+}
+
+void ReplayCache::clear()
+{
+	for (PeriodRing& ring : m_rings)
+	{
+		std::atomic<uint64_t>* slots = ring.slots.load(std::memory_order_acquire);
+		if (!slots)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < d_replay_ring_size * m_capacity; ++i)
+		{
+			slots[i].store(0, std::memory_order_relaxed);
+		}
+
+		for (std::atomic<SpillTable*>& spill : ring.spill)
+		{
+			for (SpillTable* table = spill.load(std::memory_order_acquire); table; table = table->next.load(std::memory_order_acquire))
+			{
+				for (size_t i = 0; i < table->capacity; ++i)
+				{
+					table->slots[i].store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+}
+
+} // namespace UTILS
@@ -0,0 +1,83 @@
+#ifndef REPLAY_CACHE_HPP
+#define REPLAY_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace UTILS
+{
+// Steps kept per period. Must exceed the widest acceptance range (2 * d_max_verify_window + 1) so a
+// bucket is only reused once every code recorded in it can no longer verify.
+constexpr size_t d_replay_ring_size = 32;
+
+// Distinct TOTP periods tracked at once; accounts sharing a period share a ring.
+constexpr size_t d_replay_max_periods = 8;
+
+constexpr size_t d_replay_default_capacity = 1024;
+
+// Slots an insert probes in one table before moving on to the bucket's next, larger one.
+constexpr size_t d_replay_max_probes = 16;
+
+// Tables a bucket may chain; the last one is 2^(d_replay_max_tables - 1) times the first.
+constexpr size_t d_replay_max_tables = 16;
+
+// Remembers which (account, time step) codes were already accepted.
+//
+// Each period owns a ring of per-step open-addressing sets. Every slot stores the low 32 bits of its
+// step next to the account serial, so once the ring wraps, entries from an older step simply read as
+// empty and a whole bucket expires in O(1) without being cleared. Inserts are a CAS on the slot and
+// never take a lock; rings are allocated on first use of a period.
+//
+// A bucket grows with the number of accounts verifying in one step: an insert that finds no free
+// slot within d_replay_max_probes goes on to a table twice the size, chained to the bucket on first
+// use and kept for the steps that reuse the bucket later.
+class ReplayCache
+{
+public:
+	// capacity_per_step sizes the first table of each bucket and is rounded up to a power of two.
+	explicit ReplayCache(size_t capacity_per_step = d_replay_default_capacity);
+	~ReplayCache();
+
+	ReplayCache(const ReplayCache&)			   = delete;
+	ReplayCache& operator=(const ReplayCache&) = delete;
+
+	// Records the code for (account_serial, counter). Returns false if it was already recorded or if it
+	// cannot be recorded (every table of the bucket full, too many periods), so callers fail closed.
+	bool accept(uint32_t account_serial, uint32_t period, uint64_t counter);
+
+	// Forgets every recorded code. Must not run concurrently with accept().
+	void clear();
+
+private:
+	// A bucket's tables after its first, each twice the size of the one before.
+	struct SpillTable
+	{
+		explicit SpillTable(size_t capacity);
+
+		size_t									 capacity;
+		std::unique_ptr<std::atomic<uint64_t>[]> slots;
+		std::atomic<SpillTable*>				 next = nullptr;
+	};
+
+	struct PeriodRing
+	{
+		std::atomic<uint32_t>									 period = 0;
+		std::atomic<std::atomic<uint64_t>*>						 slots  = nullptr;
+		std::array<std::atomic<SpillTable*>, d_replay_ring_size> spill {};
+	};
+
+	PeriodRing* ring_for(uint32_t period);
+
+	// 1 if the entry was recorded, 0 if it already was, -1 if no slot within reach was free.
+	static int insert(std::atomic<uint64_t>* slots, size_t capacity, uint32_t account_serial, uint64_t entry);
+
+	size_t									   m_capacity;
+	std::array<PeriodRing, d_replay_max_periods> m_rings;
+};
+
+} // namespace UTILS
+
+#endif // REPLAY_CACHE_HPP
@@ -0,0 +1,379 @@
+#include "settings_cache.hpp"
+
+#include "fnv1a.hpp"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+struct CacheImage
+{
+	std::vector<UTILS::SettingsCacheNode> nodes;
+	std::string							  strings;
+};
+
+// The cache file's contents: mapped where mmap exists, read otherwise.
+class CacheFile
+{
+public:
+	explicit CacheFile(const fs::path& path);
+	~CacheFile();
+
+	CacheFile(const CacheFile&)			   = delete;
+	CacheFile& operator=(const CacheFile&) = delete;
+
+	std::string_view contents() const;
+
+private:
+#ifdef _WIN32
+	std::string m_contents;
+#else
+	void*  m_map  = nullptr;
+	size_t m_size = 0;
+#endif
+};
+
+#ifdef _WIN32
+
+CacheFile::CacheFile(const fs::path& path)
+{
+	std::ifstream	  file(path, std::ios::in | std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	m_contents = contents.str();
+}
+
+CacheFile::~CacheFile()
+{}
+
+std::string_view CacheFile::contents() const
+{
+	return m_contents;
+}
+
+#else
+
+CacheFile::CacheFile(const fs::path& path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	struct stat status = {};
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+	{
+		void* map = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			m_map  = map;
+			m_size = static_cast<size_t>(status.st_size);
+		}
+	}
+	close(fd);
+}
+
+CacheFile::~CacheFile()
+{
+	if (m_map)
+	{
+		munmap(m_map, m_size);
+	}
+}
+
+std::string_view CacheFile::contents() const
+{
+	return {static_cast<const char*>(m_map), m_size};
+}
+
+#endif
+
+uint64_t add_string(std::string& strings, std::string_view text)
+{
+	const uint64_t offset = strings.size();
+	strings.append(text);
+	return offset;
+}
+
+bool compile_node(const toml::node& node, std::string_view key, CacheImage& image, size_t depth)
+{
+	if (depth > UTILS::d_settings_cache_max_depth)
+	{
+		return false;
+	}
+
+	UTILS::SettingsCacheNode record;
+	record.key_size	  = static_cast<uint32_t>(key.size());
+	record.key_offset = add_string(image.strings, key);
+
+	switch (node.type())
+	{
+		case toml::node_type::table:
+		{
+			const toml::table& table = *node.as_table();
+			record.type				 = UTILS::SettingsCacheType::TABLE;
+			record.value			 = table.size();
+			image.nodes.push_back(record);
+
+			for (auto&& [child_key, child] : table)
+			{
+				if (!compile_node(child, child_key.str(), image, depth + 1))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		case toml::node_type::array:
+		{
+			const toml::array& array = *node.as_array();
+			record.type				 = UTILS::SettingsCacheType::ARRAY;
+			record.value			 = array.size();
+			image.nodes.push_back(record);
+
+			for (const toml::node& child : array)
+			{
+				if (!compile_node(child, {}, image, depth + 1))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+		case toml::node_type::string:
+		{
+			const std::string& text = node.as_string()->get();
+			record.type				= UTILS::SettingsCacheType::STRING;
+			record.value			= add_string(image.strings, text);
+			record.value_size		= text.size();
+			break;
+		}
+		case toml::node_type::integer:
+			record.type	 = UTILS::SettingsCacheType::INTEGER;
+			record.value = std::bit_cast<uint64_t>(node.as_integer()->get());
+			break;
+		case toml::node_type::floating_point:
+			record.type	 = UTILS::SettingsCacheType::FLOATING_POINT;
+			record.value = std::bit_cast<uint64_t>(node.as_floating_point()->get());
+			break;
+		case toml::node_type::boolean:
+			record.type	 = UTILS::SettingsCacheType::BOOLEAN;
+			record.value = node.as_boolean()->get() ? 1 : 0;
+			break;
+		default:
+			return false;
+	}
+
+	image.nodes.push_back(record);
+	return true;
+}
+
+// Walks the records of a mapped image; every offset and size is checked against it before use.
+struct CacheReader
+{
+	const char*		 nodes		= nullptr;
+	uint64_t		 node_count = 0;
+	std::string_view strings;
+	uint64_t		 index = 0;
+
+	std::optional<UTILS::SettingsCacheNode> next()
+	{
+		if (index >= node_count)
+		{
+			return std::nullopt;
+		}
+
+		UTILS::SettingsCacheNode node;
+		std::memcpy(&node, nodes + index++ * sizeof(UTILS::SettingsCacheNode), sizeof(node));
+		return node;
+	}
+
+	std::optional<std::string_view> string(uint64_t offset, uint64_t size) const
+	{
+		if (offset > strings.size() || size > strings.size() - offset)
+		{
+			return std::nullopt;
+		}
+		return strings.substr(offset, size);
+	}
+};
+
+template<typename Container, typename Value>
+toml::node& insert_node(Container& container, std::string_view key, Value&& value)
+{
+	if constexpr (std::is_same_v<Container, toml::table>)
+	{
+		return container.insert_or_assign(key, std::forward<Value>(value)).first->second;
+	}
+	else
+	{
+		container.push_back(std::forward<Value>(value));
+		return container.back();
+	}
+}
+
+template<typename Container>
+bool load_children(CacheReader& reader, uint64_t count, Container& container, size_t depth)
+{
+	if (depth > UTILS::d_settings_cache_max_depth)
+	{
+		return false;
+	}
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		std::optional<UTILS::SettingsCacheNode> node = reader.next();
+		std::optional<std::string_view>			key	 = node ? reader.string(node->key_offset, node->key_size) : std::nullopt;
+		if (!key)
+		{
+			return false;
+		}
+
+		switch (node->type)
+		{
+			case UTILS::SettingsCacheType::TABLE:
+			{
+				toml::node& child = insert_node(container, *key, toml::table {});
+				if (!load_children(reader, node->value, *child.as_table(), depth + 1))
+				{
+					return false;
+				}
+				break;
+			}
+			case UTILS::SettingsCacheType::ARRAY:
+			{
+				toml::node& child = insert_node(container, *key, toml::array {});
+				if (!load_children(reader, node->value, *child.as_array(), depth + 1))
+				{
+					return false;
+				}
+				break;
+			}
+			case UTILS::SettingsCacheType::STRING:
+			{
+				std::optional<std::string_view> text = reader.string(node->value, node->value_size);
+				if (!text)
+				{
+					return false;
+				}
+				insert_node(container, *key, std::string(*text));
+				break;
+			}
+			case UTILS::SettingsCacheType::INTEGER:
+				insert_node(container, *key, std::bit_cast<int64_t>(node->value));
+				break;
+			case UTILS::SettingsCacheType::FLOATING_POINT:
+				insert_node(container, *key, std::bit_cast<double>(node->value));
+				break;
+			case UTILS::SettingsCacheType::BOOLEAN:
+				insert_node(container, *key, node->value != 0);
+				break;
+			default:
+				return false;
+		}
+	}
+
+	return true;
+}
+} // namespace
+
+namespace UTILS
+{
+
+fs::path settings_cache_path(const fs::path& source_path)
+{
+	return fs::path(source_path).concat(".cache");
+}
+
+std::optional<std::string> compile_settings_cache(const toml::table& settings)
+{
+	CacheImage image;
+	if (!compile_node(settings, {}, image, 0))
+	{
+		return std::nullopt;
+	}
+
+	SettingsCacheHeader header;
+	header.node_count  = image.nodes.size();
+	header.string_size = image.strings.size();
+
+	std::string result;
+	result.reserve(sizeof(header) + image.nodes.size() * sizeof(SettingsCacheNode) + image.strings.size());
+	result.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	result.append(reinterpret_cast<const char*>(image.nodes.data()), image.nodes.size() * sizeof(SettingsCacheNode));
+	result.append(image.strings);
+
+	return result;
+}
+
+void stamp_settings_cache(std::string& image, int64_t source_time, std::string_view source)
+{
+	SettingsCacheHeader header;
+	if (image.size() < sizeof(header))
+	{
+		return;
+	}
+
+	std::memcpy(&header, image.data(), sizeof(header));
+	header.source_time = source_time;
+	header.source_size = source.size();
+	header.source_hash = TOTPCLIENT::fnv1a_hash(source);
+	std::memcpy(image.data(), &header, sizeof(header));
+}
+
+std::optional<toml::table> load_settings_cache(const fs::path& cache_path, int64_t source_time, std::string_view source)
+{
+	const CacheFile		   file(cache_path);
+	const std::string_view contents = file.contents();
+
+	SettingsCacheHeader header;
+	if (contents.size() < sizeof(header))
+	{
+		return std::nullopt;
+	}
+	std::memcpy(&header, contents.data(), sizeof(header));
+
+	// Cheapest checks first: the source is hashed only once everything else matches.
+	const uint64_t record_space = contents.size() - sizeof(header);
+	if (header.magic != d_settings_cache_magic || header.version != d_settings_cache_version || header.source_time != source_time
+		|| header.source_size != source.size() || header.node_count == 0 || header.node_count > record_space / sizeof(SettingsCacheNode)
+		|| header.string_size != record_space - header.node_count * sizeof(SettingsCacheNode)
+		|| header.source_hash != TOTPCLIENT::fnv1a_hash(source))
+	{
+		return std::nullopt;
+	}
+
+	CacheReader reader;
+	reader.nodes	  = contents.data() + sizeof(header);
+	reader.node_count = header.node_count;
+	reader.strings	  = contents.substr(sizeof(header) + header.node_count * sizeof(SettingsCacheNode));
+
+	std::optional<SettingsCacheNode> root = reader.next();
+	if (!root || root->type != SettingsCacheType::TABLE)
+	{
+		return std::nullopt;
+	}
+
+	toml::table settings;
+	if (!load_children(reader, root->value, settings, 1) || reader.index != reader.node_count)
+	{
+		return std::nullopt;
+	}
+
+	return settings;
+}
+
+} // namespace UTILS
@@ -0,0 +1,71 @@
+#ifndef SETTINGS_CACHE_HPP
+#define SETTINGS_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <toml++/toml.hpp>
+
+namespace fs = std::filesystem;
+
+namespace UTILS
+{
+// A compiled settings file: the parsed table flattened into one buffer and stored next to the file as
+// "<file>.cache", so a start with an unchanged file maps it instead of running the TOML parser.
+//
+// The image is one SettingsCacheHeader, then header.node_count SettingsCacheNode records in pre-order
+// (a table or array is followed by its children), then a blob holding every key and string. The
+// header records the write time, size and hash of the source it was compiled from; the image is used
+// only while all three still match.
+constexpr uint32_t d_settings_cache_magic	  = 0x31435354;
+constexpr uint32_t d_settings_cache_version	  = 1;
+constexpr size_t   d_settings_cache_max_depth = 256;
+
+enum class SettingsCacheType : uint8_t
+{
+	TABLE,
+	ARRAY,
+	STRING,
+	INTEGER,
+	FLOATING_POINT,
+	BOOLEAN
+};
+
+struct SettingsCacheHeader
+{
+	uint32_t magic		 = d_settings_cache_magic;
+	uint32_t version	 = d_settings_cache_version;
+	int64_t	 source_time = 0; // write time of the source, in file clock ticks
+	uint64_t source_size = 0;
+	uint64_t source_hash = 0;
+	uint64_t node_count	 = 0;
+	uint64_t string_size = 0;
+};
+
+struct SettingsCacheNode
+{
+	SettingsCacheType type		  = SettingsCacheType::TABLE;
+	uint8_t			  reserved[3] = {};
+	uint32_t		  key_size	  = 0; // 0 for array elements
+	uint64_t		  key_offset  = 0;
+	uint64_t		  value		  = 0; // child count, integer, double bits, bool or string offset
+	uint64_t		  value_size  = 0; // string size
+};
+
+static_assert(sizeof(SettingsCacheHeader) == 48 && sizeof(SettingsCacheNode) == 32);
+
+fs::path settings_cache_path(const fs::path& source_path);
+
+// Flattens the settings into an image, or nullopt if they hold values it cannot represent (dates and
+// times). stamp_settings_cache() then records the source the image stands for.
+std::optional<std::string> compile_settings_cache(const toml::table& settings);
+void					   stamp_settings_cache(std::string& image, int64_t source_time, std::string_view source);
+
+// Maps the image at cache_path and rebuilds the settings from it, if it was compiled from this source.
+std::optional<toml::table> load_settings_cache(const fs::path& cache_path, int64_t source_time, std::string_view source);
+
+} // namespace UTILS
+
+#endif // SETTINGS_CACHE_HPP
@@ -1,11 +1,28 @@
 #include "settings_manager.hpp"
 
+#include "settings_cache.hpp"
 #include "spdlog_wrapper.hpp"
 
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <toml++/impl/table.hpp>
 
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
 namespace
 {
 std::string getenv_safe(const char *name)
@@ -52,9 +69,17 @@ static constexpr std::string_view default_toml_format = R"(
     [application]
     name = "{project_name}"
     authors = ["{developer_name} <{developer_email}>"]
+    settings-cache = false
     [totp]
     secret = ""
     account_name = ""
+    period = 30
+    digits = 6
+    algorithm = "SHA1"
+    vault = ""
+    [totp.accounts]
+    [http]
+    token = ""
     [notifications]
     enabled = false
     uri = ""
@@ -66,6 +91,193 @@ std::string default_toml = fmt::format(default_toml_format,
 									   fmt::arg("project_name", COMMON::d_project_name),
 									   fmt::arg("developer_name", COMMON::d_developer_name),
 									   fmt::arg("developer_email", COMMON::d_developer_email));
+
+// Writes a sibling temporary file and renames it over file_path, so readers and crashes only ever see
+// the old contents or the new ones. A symlinked settings file is replaced at its target. Files that can
+// be rebuilt skip the fsync.
+bool write_file_atomically(const fs::path &file_path, std::string_view contents, bool durable = true)
+{
+	const fs::path target_path	  = fs::is_symlink(file_path) ? fs::canonical(file_path) : file_path;
+	const fs::path temporary_path = fs::path(target_path).concat(".tmp");
+
+#ifdef _WIN32
+	{
+		std::ofstream file(temporary_path, std::ios::out | std::ios::trunc | std::ios::binary);
+		file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+		file.close();
+
+		if (file.fail())
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to write config file: {}", temporary_path.string()));
+			fs::remove(temporary_path);
+			return false;
+		}
+	}
+
+	fs::rename(temporary_path, target_path);
+	return true;
+#else
+	// The settings hold secrets: the file is created private, whatever the umask.
+	int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create config file {}: {}", temporary_path.string(), strerror(errno)));
+		return false;
+	}
+
+	size_t offset = 0;
+	while (offset < contents.size())
+	{
+		const ssize_t written = write(fd, contents.data() + offset, contents.size() - offset);
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (written <= 0)
+		{
+			break;
+		}
+		offset += static_cast<size_t>(written);
+	}
+
+	// One fsync, of the data, before the rename publishes it.
+	bool written = offset == contents.size() && (!durable || fsync(fd) == 0);
+	written		 = close(fd) == 0 && written;
+
+	if (!written || rename(temporary_path.c_str(), target_path.c_str()) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to write config file {}: {}", target_path.string(), strerror(errno)));
+		unlink(temporary_path.c_str());
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+// Write time and size of a file, through symlinks.
+bool file_stamp(const fs::path &file_path, fs::file_time_type &file_time, uintmax_t &file_size)
+{
+	std::error_code error;
+	file_time = fs::last_write_time(file_path, error);
+	if (!error)
+	{
+		file_size = fs::file_size(file_path, error);
+	}
+	return !error;
+}
+
+bool is_cache_enabled(const toml::table &settings)
+{
+	const toml::node *application = settings.get("application");
+	const toml::node *enabled	  = application && application->is_table() ? application->as_table()->get("settings-cache") : nullptr;
+	return enabled && enabled->value_or(false);
+}
+
+// Brings the compiled cache of a settings file in line with it: rewritten when the settings ask for
+// one, removed otherwise so no stale copy of the secrets lingers.
+void update_settings_cache(const fs::path &file_path, std::optional<std::string> image, std::string_view source)
+{
+	const fs::path	cache_path = UTILS::settings_cache_path(file_path);
+	std::error_code error;
+
+	if (!image)
+	{
+		fs::remove(cache_path, error);
+		return;
+	}
+
+	const fs::file_time_type source_time = fs::last_write_time(file_path, error);
+	if (error)
+	{
+		return;
+	}
+
+	UTILS::stamp_settings_cache(*image, source_time.time_since_epoch().count(), source);
+	write_file_atomically(cache_path, *image, false);
+}
+
+// Parses a settings file, or rebuilds it from the compiled cache if that was made from this very file.
+toml::table read_settings_file(const fs::path &file_path)
+{
+	std::ifstream file(file_path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("cannot open file");
+	}
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string source = contents.str();
+
+	// Stamped after reading: if the file changes in between, the hash no longer matches and the next
+	// start parses again.
+	std::error_code			 error;
+	const fs::file_time_type source_time = fs::last_write_time(file_path, error);
+	if (!error)
+	{
+		if (std::optional<toml::table> settings =
+				UTILS::load_settings_cache(UTILS::settings_cache_path(file_path), source_time.time_since_epoch().count(), source))
+		{
+			SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, fmt::format("Settings loaded from the compiled cache of {}.", file_path.string()));
+			return std::move(*settings);
+		}
+	}
+
+	toml::table settings = toml::parse(source, file_path.string());
+	if (!error)
+	{
+		update_settings_cache(file_path, is_cache_enabled(settings) ? UTILS::compile_settings_cache(settings) : std::nullopt, source);
+	}
+
+	return settings;
+}
+
+bool is_same_node(const toml::node &left, const toml::node &right)
+{
+	return left.type() == right.type() && left.visit([&right](const auto &value) {
+		using Node = std::remove_cvref_t<decltype(value)>;
+		return value == *right.as<Node>();
+	});
+}
+
+// Appends the dotted path of every setting that differs between the tables. Tables present on both
+// sides are compared key by key; anything added, removed or of another type is reported whole.
+void diff_tables(const toml::table &previous, const toml::table &current, const std::string &prefix, std::vector<std::string> &changed_paths)
+{
+	for (auto &&[key, node] : previous)
+	{
+		const std::string  path			= prefix.empty() ? std::string(key.str()) : prefix + "." + std::string(key.str());
+		const toml::node  *current_node = current.get(key.str());
+		const toml::table *table		= node.as_table();
+
+		if (table && current_node && current_node->is_table())
+		{
+			diff_tables(*table, *current_node->as_table(), path, changed_paths);
+		}
+		else if (!current_node || !is_same_node(node, *current_node))
+		{
+			changed_paths.push_back(path);
+		}
+	}
+
+	for (auto &&[key, node] : current)
+	{
+		if (!previous.get(key.str()))
+		{
+			changed_paths.push_back(prefix.empty() ? std::string(key.str()) : prefix + "." + std::string(key.str()));
+		}
+	}
+}
+
+// True if a change at path concerns a subscriber to prefix: one lies within the other.
+bool is_covered(std::string_view prefix, std::string_view path)
+{
+	const std::string_view shorter = prefix.size() < path.size() ? prefix : path;
+	const std::string_view longer  = prefix.size() < path.size() ? path : prefix;
+
+	return prefix.empty() || (longer.starts_with(shorter) && (longer.size() == shorter.size() || longer[shorter.size()] == '.'));
+}
 } // anonymous namespace
 
 namespace UTILS
@@ -173,7 +385,10 @@ bool SettingsManager::load_settings(fs::path file_path)
 
 	try
 	{
-		this->m_config = std::make_unique<toml::table>(toml::parse_file(file_path.string()));
+		this->m_config = std::make_unique<toml::table>(read_settings_file(file_path));
+		m_generation.fetch_add(1, std::memory_order_release);
+		m_saved_changes = m_changes;
+		file_stamp(file_path, m_file_time, m_file_size);
 	}
 	catch (const std::exception &error)
 	{
@@ -195,6 +410,16 @@ bool SettingsManager::save_settings()
 		this->create_default_settings();
 	}
 
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+
+		if (m_changes == m_saved_changes && !this->m_config_path.empty() && fs::exists(this->m_config_path))
+		{
+			SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, "Settings unchanged, nothing to save.");
+			return true;
+		}
+	}
+
 	if (!this->m_config_path.empty() && !fs::is_directory(this->m_config_path))
 	{
 		if (this->save_settings(this->m_config_path))
@@ -229,19 +454,43 @@ bool SettingsManager::save_settings()
 
 bool SettingsManager::save_settings(fs::path file_path)
 {
-	std::lock_guard<std::mutex> lock(m_settings_mutex);
+	std::lock_guard<std::mutex> save_lock(m_save_mutex);
 
 	if (fs::is_directory(file_path) || file_path.empty())
 	{
 		return false;
 	}
 
-	if (!this->m_config)
+	// Serialized under the settings lock, written outside it so readers never wait on the disk.
+	std::string				   contents;
+	uint64_t				   changes = 0;
+	bool					   is_config_file = false;
+	std::optional<std::string> cache_image;
 	{
-		if (!restore_defaults())
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+
+		if (!this->m_config)
 		{
-			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "Cannot save settings without a default configuration.");
-			return false;
+			if (!this->m_config_default)
+			{
+				SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "Cannot save settings without a default configuration.");
+				return false;
+			}
+
+			this->m_config = std::make_unique<toml::table>(*this->m_config_default.get());
+			m_generation.fetch_add(1, std::memory_order_release);
+			++m_changes;
+		}
+
+		std::ostringstream ss;
+		ss << *this->m_config.get();
+		contents	   = ss.str();
+		changes		   = m_changes;
+		is_config_file = this->m_config_path.empty() || this->m_config_path == file_path;
+
+		if (is_config_file && is_cache_enabled(*this->m_config))
+		{
+			cache_image = compile_settings_cache(*this->m_config);
 		}
 	}
 
@@ -257,17 +506,15 @@ bool SettingsManager::save_settings(fs::path file_path)
 			}
 		}
 
-		std::ofstream file(file_path, std::ios::out | std::ios::trunc);
-
-		if (!file.is_open())
+		if (!write_file_atomically(file_path, contents))
 		{
-			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create config file: {}", file_path.string()));
 			return false;
 		}
 
-		file << *this->m_config.get();
-
-		file.close();
+		if (is_config_file)
+		{
+			update_settings_cache(file_path, std::move(cache_image), contents);
+		}
 	}
 	catch (const fs::filesystem_error &e)
 	{
@@ -276,6 +523,13 @@ bool SettingsManager::save_settings(fs::path file_path)
 		return false;
 	}
 
+	std::lock_guard<std::mutex> lock(m_settings_mutex);
+	if (is_config_file)
+	{
+		m_saved_changes = std::max(m_saved_changes, changes);
+		file_stamp(file_path, m_file_time, m_file_size);
+	}
+
 	return true;
 }
 
@@ -289,10 +543,273 @@ bool SettingsManager::restore_defaults()
 	}
 
 	this->m_config = std::make_unique<toml::table>(*this->m_config_default.get());
+	m_generation.fetch_add(1, std::memory_order_release);
+	++m_changes;
 
 	return true;
 }
 
+bool SettingsManager::reload_settings()
+{
+	fs::path file_path;
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+		file_path = this->m_config_path;
+	}
+
+	fs::file_time_type file_time;
+	uintmax_t		   file_size = 0;
+	if (file_path.empty() || !file_stamp(file_path, file_time, file_size))
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+		if (file_time == m_file_time && file_size == m_file_size)
+		{
+			return true;
+		}
+	}
+
+	// Parsed outside the lock; a write racing with it changes the stamp and triggers another reload.
+	std::unique_ptr<toml::table> config;
+	try
+	{
+		config = std::make_unique<toml::table>(read_settings_file(file_path));
+	}
+	catch (const std::exception &error)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils,
+						fmt::format("Failed to parse settings file at {}, keeping the current settings: {}", file_path.string(), error.what()));
+		return false;
+	}
+
+	std::vector<std::string> changed_paths;
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+
+		if (m_changes != m_saved_changes)
+		{
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils, "Settings file changed on disk, discarding unsaved settings changes.");
+		}
+
+		const toml::table empty;
+		diff_tables(this->m_config ? *this->m_config : empty, *config, std::string(), changed_paths);
+
+		this->m_config = std::move(config);
+		m_generation.fetch_add(1, std::memory_order_release);
+		m_saved_changes = m_changes;
+		m_file_time		= file_time;
+		m_file_size		= file_size;
+	}
+
+	if (changed_paths.empty())
+	{
+		return true;
+	}
+
+	SPD_INFO_CLASS(COMMON::d_settings_group_utils,
+				   fmt::format("Settings reloaded from {}: {} setting(s) changed.", file_path.string(), changed_paths.size()));
+
+	std::lock_guard<std::mutex> lock(m_subscription_mutex);
+	for (const Subscription &subscription : m_subscriptions)
+	{
+		std::vector<std::string> matched_paths;
+		for (const std::string &path : changed_paths)
+		{
+			if (is_covered(subscription.prefix, path))
+			{
+				matched_paths.push_back(path);
+			}
+		}
+
+		if (!matched_paths.empty())
+		{
+			subscription.callback(matched_paths);
+		}
+	}
+
+	return true;
+}
+
+SubscriptionId SettingsManager::subscribe(std::string_view prefix, SettingsCallback callback)
+{
+	if (prefix.ends_with("*"))
+	{
+		prefix.remove_suffix(1);
+	}
+	if (prefix.ends_with("."))
+	{
+		prefix.remove_suffix(1);
+	}
+
+	std::lock_guard<std::mutex> lock(m_subscription_mutex);
+	m_subscriptions.push_back({m_next_subscription, std::string(prefix), std::move(callback)});
+
+	return m_next_subscription++;
+}
+
+void SettingsManager::unsubscribe(SubscriptionId id)
+{
+	std::lock_guard<std::mutex> lock(m_subscription_mutex);
+	std::erase_if(m_subscriptions, [id](const Subscription &subscription) { return subscription.id == id; });
+}
+
+#ifdef _WIN32
+
+bool SettingsManager::watch_settings()
+{
+	SPD_WARN_CLASS(COMMON::d_settings_group_utils, "Watching the settings file is not supported on this platform.");
+	return false;
+}
+
+void SettingsManager::stop_watching()
+{}
+
+#else
+
+bool SettingsManager::watch_settings()
+{
+	if (m_watch_thread.joinable())
+	{
+		return true;
+	}
+
+	fs::path file_path;
+	{
+		std::lock_guard<std::mutex> lock(m_settings_mutex);
+		file_path = this->m_config_path;
+	}
+
+	// Watch the directory, not the file: editors and save_settings() replace the file by renaming.
+	std::error_code error;
+	const fs::path	target_path = file_path.empty() ? fs::path() : fs::canonical(file_path, error);
+	if (target_path.empty() || error)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "No settings file to watch.");
+		return false;
+	}
+
+	int inotify_fd	= inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	m_watch_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (inotify_fd < 0 || m_watch_stop_fd < 0 || inotify_add_watch(inotify_fd, target_path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils,
+						fmt::format("Failed to watch settings file {}: {}", target_path.string(), strerror(errno)));
+		if (inotify_fd >= 0)
+		{
+			close(inotify_fd);
+		}
+		if (m_watch_stop_fd >= 0)
+		{
+			close(m_watch_stop_fd);
+			m_watch_stop_fd = -1;
+		}
+		return false;
+	}
+
+	// The daemon and HTTP server receive SIGINT and SIGTERM through a signalfd, which only works
+	// while every thread blocks them; the watcher inherits a fully blocked mask.
+	sigset_t signals;
+	sigset_t previous_signals;
+	sigfillset(&signals);
+	pthread_sigmask(SIG_SETMASK, &signals, &previous_signals);
+	m_watch_thread = std::thread(&SettingsManager::watch_loop, this, inotify_fd, target_path.filename().string());
+	pthread_sigmask(SIG_SETMASK, &previous_signals, nullptr);
+
+	SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, fmt::format("Watching settings file {}.", target_path.string()));
+	return true;
+}
+
+void SettingsManager::stop_watching()
+{
+	if (!m_watch_thread.joinable())
+	{
+		return;
+	}
+
+	const uint64_t stop = 1;
+	if (write(m_watch_stop_fd, &stop, sizeof(stop)) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to stop the settings watcher: {}", strerror(errno)));
+	}
+
+	m_watch_thread.join();
+	close(m_watch_stop_fd);
+	m_watch_stop_fd = -1;
+}
+
+void SettingsManager::watch_loop(int inotify_fd, std::string file_name)
+{
+	pollfd descriptors[2] = {
+		{inotify_fd, POLLIN, 0},
+		{m_watch_stop_fd, POLLIN, 0},
+	};
+
+	alignas(inotify_event) char buffer[4096];
+	bool						pending = false;
+
+	while (true)
+	{
+		const int ready = poll(descriptors, 2, pending ? d_settings_reload_settle_ms : -1);
+		if (ready < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (ready < 0)
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Settings watcher failed: {}", strerror(errno)));
+			break;
+		}
+
+		if (descriptors[1].revents != 0)
+		{
+			break;
+		}
+
+		if (ready == 0)
+		{
+			pending = false;
+			this->reload_settings();
+			continue;
+		}
+
+		const ssize_t size = read(inotify_fd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < size;)
+		{
+			const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+			if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && file_name == event->name))
+			{
+				pending = true;
+			}
+			offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+		}
+	}
+
+	close(inotify_fd);
+}
+
+#endif
+
+toml::table SettingsManager::get_table(std::string_view path) const
+{
+	std::lock_guard<std::mutex> lock(m_settings_mutex);
+
+	if (!this->m_config)
+	{
+		return {};
+	}
+
+	const toml::node *current_node = this->find_node(this->split_path(path));
+	if (!current_node || !current_node->is_table())
+	{
+		return {};
+	}
+
+	return *current_node->as_table();
+}
+
 std::string SettingsManager::dump() const
 {
 	if (!m_config)
@@ -318,6 +835,6 @@ void SettingsManager::dump(std::ostream &output) const
 
 SettingsManager::~SettingsManager()
 {
-	return;
+	this->stop_watching();
 }
 } // namespace UTILS
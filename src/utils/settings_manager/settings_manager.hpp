@@ -3,21 +3,73 @@
 
 #include "manager_singleton.hpp"
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <toml++/toml.hpp>
+#include <type_traits>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 namespace UTILS
 {
+class SettingsManager;
+
+// Receives the dotted paths of the settings a reload changed, limited to the subscribed prefix.
+using SettingsCallback = std::function<void(const std::vector<std::string>& changed_paths)>;
+using SubscriptionId   = uint64_t;
+
+// Editors often write a file in several steps; the watcher reloads once it has been quiet this long.
+constexpr int d_settings_reload_settle_ms = 100;
+
+// Whether a set_setting() change has to reach the settings file.
+enum class SettingPersistence : uint8_t
+{
+	SAVED,	  // marks the settings dirty, so the next save writes them
+	TRANSIENT // kept in memory, and written only along with a saved change
+};
+
+// A setting whose dotted path is split once, when the handle is made. get() returns the cached value
+// after one atomic load while the settings are unchanged; loading, restoring or setting anything bumps
+// the manager's generation, and the next get() re-resolves the path under the settings lock.
+// A handle does not synchronize itself: give each thread its own, or guard a shared one.
+template<typename T>
+class SettingHandle
+{
+public:
+	SettingHandle() = default;
+
+	const T& get() const;
+
+private:
+	friend class SettingsManager;
+
+	SettingHandle(const SettingsManager* settings_manager, std::string_view path, T default_value);
+
+	void refresh() const;
+
+	const SettingsManager*	 m_settings_manager = nullptr;
+	std::vector<std::string> m_keys;
+	T						 m_default_value {};
+	mutable T				 m_value {};
+	mutable uint64_t		 m_generation = 0;
+};
+
 class SettingsManager : public UTILS::ManagerSingleton<SettingsManager>
 {
 	friend class ManagerSingleton<SettingsManager>;
 
+	template<typename T>
+	friend class SettingHandle;
+
 private:
 	SettingsManager() = default;
 
@@ -27,6 +79,22 @@ private:
 
 	static std::vector<std::string_view> split_path(std::string_view path);
 
+	// Walks the loaded tree; the caller holds m_settings_mutex.
+	template<typename Keys>
+	const toml::node* find_node(const Keys& keys) const;
+
+	template<typename T>
+	static bool is_same_value(const toml::node& node, const T& value);
+
+	void watch_loop(int inotify_fd, std::string file_name);
+
+	struct Subscription
+	{
+		SubscriptionId	 id;
+		std::string		 prefix;
+		SettingsCallback callback;
+	};
+
 public:
 	std::string_view get_manager_name() const override;
 
@@ -34,15 +102,42 @@ public:
 
 	bool load_settings();
 	bool load_settings(fs::path file_path);
+
+	// Writes the settings file unless nothing changed since it was loaded or last written. Writes go
+	// to a temporary file that is synced and renamed over the old one, so a crash never leaves a
+	// truncated file behind.
 	bool save_settings();
 	bool save_settings(fs::path file_path);
 	bool restore_defaults();
 
+	// Re-reads the settings file unless it is still the one loaded or saved last, and notifies the
+	// subscribers of every setting that differs. Unsaved changes are dropped: the file wins. If it
+	// cannot be parsed the current settings stay.
+	bool reload_settings();
+
+	// Reloads whenever the settings file changes on disk, from a background thread (inotify, Linux
+	// only) that also runs the callbacks. This process's own saves are recognised and skipped.
+	bool watch_settings();
+	void stop_watching();
+
+	// A prefix of "totp" or "totp.*" matches changes to totp.period and totp.accounts.x.secret, and to
+	// the totp table as a whole; an empty one matches everything. Callbacks must not subscribe or
+	// unsubscribe.
+	SubscriptionId subscribe(std::string_view prefix, SettingsCallback callback);
+	void		   unsubscribe(SubscriptionId id);
+
 	template<typename T>
 	T get_setting(std::string_view path, T default_value) const;
 
+	// Setting a value equal to the current one changes nothing and leaves the settings clean.
+	template<typename T>
+	bool set_setting(std::string_view path, T value, SettingPersistence persistence = SettingPersistence::SAVED);
+
+	// For settings read on hot paths: resolves the path once instead of on every read.
 	template<typename T>
-	bool set_setting(std::string_view path, T value);
+	SettingHandle<T> get_handle(std::string_view path, T default_value) const;
+
+	toml::table get_table(std::string_view path) const;
 
 	std::string dump() const;
 	void		dump(std::ostream& output) const;
@@ -52,6 +147,29 @@ private:
 	std::unique_ptr<toml::table> m_config;
 	std::unique_ptr<toml::table> m_config_default;
 
+	// Bumped under m_settings_mutex whenever m_config changes; handles compare it to their snapshot.
+	std::atomic<uint64_t> m_generation = 1;
+
+	// Saved changes made so far, and how many of them the settings file holds; both under
+	// m_settings_mutex. The file is dirty while they differ.
+	uint64_t m_changes		 = 0;
+	uint64_t m_saved_changes = 0;
+
+	// Serializes writers of the temporary file.
+	std::mutex m_save_mutex;
+
+	// The settings file as last loaded or saved, under m_settings_mutex; reload_settings() skips a
+	// file that still matches.
+	fs::file_time_type m_file_time;
+	uintmax_t		   m_file_size = 0;
+
+	std::vector<Subscription> m_subscriptions;
+	SubscriptionId			  m_next_subscription = 1;
+	std::mutex				  m_subscription_mutex;
+
+	std::thread m_watch_thread;
+	int			m_watch_stop_fd = -1;
+
 protected:
 	mutable std::mutex m_settings_mutex;
 };
@@ -66,26 +184,96 @@ T SettingsManager::get_setting(std::string_view path, T default_value) const
 		return default_value;
 	}
 
+	const toml::node* current_node = this->find_node(this->split_path(path));
+	if (!current_node)
+	{
+		return default_value;
+	}
+
+	return current_node->value_or(default_value);
+}
+
+template<typename Keys>
+const toml::node* SettingsManager::find_node(const Keys& keys) const
+{
 	const toml::node* current_node = this->m_config.get();
-	for (const auto& key : this->split_path(path))
+	for (const auto& key : keys)
 	{
 		if (!current_node || !current_node->is_table())
 		{
-			return default_value;
+			return nullptr;
 		}
 		current_node = current_node->as_table()->get(key);
 	}
 
-	if (!current_node)
+	return current_node;
+}
+
+template<typename T>
+SettingHandle<T> SettingsManager::get_handle(std::string_view path, T default_value) const
+{
+	return SettingHandle<T>(this, path, std::move(default_value));
+}
+
+template<typename T>
+SettingHandle<T>::SettingHandle(const SettingsManager* settings_manager, std::string_view path, T default_value)
+	: m_settings_manager(settings_manager)
+	, m_default_value(std::move(default_value))
+{
+	for (std::string_view key : SettingsManager::split_path(path))
 	{
-		return default_value;
+		m_keys.emplace_back(key);
 	}
 
-	return current_node->value_or(default_value);
+	this->refresh();
+}
+
+template<typename T>
+const T& SettingHandle<T>::get() const
+{
+	if (m_settings_manager && m_generation != m_settings_manager->m_generation.load(std::memory_order_acquire))
+	{
+		this->refresh();
+	}
+
+	return m_value;
+}
+
+template<typename T>
+void SettingHandle<T>::refresh() const
+{
+	std::lock_guard<std::mutex> lock(m_settings_manager->m_settings_mutex);
+
+	m_generation				   = m_settings_manager->m_generation.load(std::memory_order_relaxed);
+	const toml::node* current_node = m_settings_manager->m_config ? m_settings_manager->find_node(m_keys) : nullptr;
+	m_value						   = current_node ? current_node->value_or(m_default_value) : m_default_value;
+}
+
+template<typename T>
+bool SettingsManager::is_same_value(const toml::node& node, const T& value)
+{
+	if constexpr (std::is_same_v<T, toml::table>)
+	{
+		const toml::table* current = node.as_table();
+		return current && *current == value;
+	}
+	else if constexpr (std::is_same_v<T, toml::array>)
+	{
+		const toml::array* current = node.as_array();
+		return current && *current == value;
+	}
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+	{
+		return node.value<std::string_view>() == std::string_view(value);
+	}
+	else
+	{
+		return node.value<T>() == value;
+	}
 }
 
 template<typename T>
-bool SettingsManager::set_setting(std::string_view path, T value)
+bool SettingsManager::set_setting(std::string_view path, T value, SettingPersistence persistence)
 {
 	std::lock_guard<std::mutex> lock(m_settings_mutex);
 
@@ -129,7 +317,19 @@ bool SettingsManager::set_setting(std::string_view path, T value)
 		}
 	}
 
-	current_table->insert_or_assign(keys.back(), value);
+	const toml::node* current_node = current_table->get(keys.back());
+	if (current_node && this->is_same_value(*current_node, value))
+	{
+		return true;
+	}
+
+	current_table->insert_or_assign(keys.back(), std::move(value));
+	m_generation.fetch_add(1, std::memory_order_release);
+
+	if (persistence == SettingPersistence::SAVED)
+	{
+		++m_changes;
+	}
 
 	return true;
 }
@@ -0,0 +1,199 @@
+#include "terminal_screen.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <spdlog/fmt/fmt.h>
+
+#ifdef _WIN32
+#include <cstdio>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// A cursor move costs up to ~10 bytes, so gaps shorter than this are cheaper to rewrite.
+constexpr size_t d_max_rewritten_gap = 8;
+} // namespace
+
+namespace UTILS
+{
+
+std::pair<size_t, size_t> TerminalScreen::terminal_size()
+{
+#ifdef _WIN32
+	CONSOLE_SCREEN_BUFFER_INFO info;
+	if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+	{
+		return {static_cast<size_t>(info.srWindow.Bottom - info.srWindow.Top + 1), static_cast<size_t>(info.srWindow.Right - info.srWindow.Left + 1)};
+	}
+#else
+	winsize size = {};
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0)
+	{
+		return {size.ws_row, size.ws_col};
+	}
+#endif
+
+	return {24, 80};
+}
+
+void TerminalScreen::resize(size_t rows, size_t columns)
+{
+	if (rows == m_rows && columns == m_columns)
+	{
+		return;
+	}
+
+	m_rows	  = rows;
+	m_columns = columns;
+	m_front.assign(rows * columns, ' ');
+	m_back.assign(rows * columns, ' ');
+
+	// Worst case is every cell plus a cursor move per row.
+	m_frame.reserve(rows * (columns + 16) + 16);
+	m_full_redraw = true;
+}
+
+size_t TerminalScreen::rows() const
+{
+	return m_rows;
+}
+
+size_t TerminalScreen::columns() const
+{
+	return m_columns;
+}
+
+void TerminalScreen::clear()
+{
+	std::fill(m_back.begin(), m_back.end(), ' ');
+}
+
+void TerminalScreen::put(size_t row, size_t column, std::string_view text)
+{
+	if (row >= m_rows || column >= m_columns)
+	{
+		return;
+	}
+
+	text = text.substr(0, m_columns - column);
+	std::copy(text.begin(), text.end(), m_back.begin() + row * m_columns + column);
+}
+
+size_t TerminalScreen::present()
+{
+	m_frame.clear();
+
+	if (m_full_redraw)
+	{
+		m_frame.append("\x1b[H\x1b[2J");
+		m_cursor_row	= 0;
+		m_cursor_column = 0;
+		std::fill(m_front.begin(), m_front.end(), ' ');
+		m_full_redraw = false;
+	}
+
+	for (size_t row = 0; row < m_rows; ++row)
+	{
+		const char* back  = m_back.data() + row * m_columns;
+		char*		front = m_front.data() + row * m_columns;
+
+		size_t column = 0;
+		while (column < m_columns)
+		{
+			if (back[column] == front[column])
+			{
+				++column;
+				continue;
+			}
+
+			// Extend the run over further changes separated by short unchanged gaps.
+			size_t end = column + 1;
+			for (size_t scan = end; scan < m_columns && scan - end <= d_max_rewritten_gap; ++scan)
+			{
+				if (back[scan] != front[scan])
+				{
+					end = scan + 1;
+				}
+			}
+
+			this->move_cursor(row, column);
+			m_frame.append(back + column, end - column);
+			std::copy(back + column, back + end, front + column);
+
+			m_cursor_column = end;
+			column			= end;
+		}
+	}
+
+	if (!m_frame.empty())
+	{
+		this->write_frame();
+	}
+
+	return m_frame.size();
+}
+
+void TerminalScreen::invalidate()
+{
+	m_full_redraw = true;
+}
+
+void TerminalScreen::enter()
+{
+	m_frame = "\x1b[?1049h\x1b[?25l";
+	this->write_frame();
+	m_full_redraw = true;
+}
+
+void TerminalScreen::leave()
+{
+	m_frame = "\x1b[?25h\x1b[?1049l";
+	this->write_frame();
+}
+
+void TerminalScreen::move_cursor(size_t row, size_t column)
+{
+	if (row == m_cursor_row && column == m_cursor_column)
+	{
+		return;
+	}
+
+	fmt::format_to(std::back_inserter(m_frame), "\x1b[{};{}H", row + 1, column + 1);
+	m_cursor_row	= row;
+	m_cursor_column = column;
+}
+
+void TerminalScreen::write_frame()
+{
+#ifdef _WIN32
+	fwrite(m_frame.data(), 1, m_frame.size(), stdout);
+	fflush(stdout);
+#else
+	const char* data	  = m_frame.data();
+	size_t		remaining = m_frame.size();
+
+	while (remaining > 0)
+	{
+		ssize_t written = write(STDOUT_FILENO, data, remaining);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+
+		data += written;
+		remaining -= static_cast<size_t>(written);
+	}
+#endif
+}
+
+} // namespace UTILS
@@ -0,0 +1,57 @@
+#ifndef TERMINAL_SCREEN_HPP
+#define TERMINAL_SCREEN_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace UTILS
+{
+// Double-buffered character grid for full-screen terminal output.
+//
+// Callers draw the whole frame into the back buffer with put(); present() compares it with what
+// the terminal already shows and emits only the changed cells, as cursor moves plus text, in a
+// single write() to stdout. Short unchanged gaps on a row are rewritten rather than skipped because
+// that is cheaper than another cursor move. Cells hold single-byte characters.
+class TerminalScreen
+{
+public:
+	// Rows and columns of the controlling terminal, or 24x80 when it cannot be queried.
+	static std::pair<size_t, size_t> terminal_size();
+
+	// Changing the size forces a full redraw on the next present().
+	void   resize(size_t rows, size_t columns);
+	size_t rows() const;
+	size_t columns() const;
+
+	void clear();
+	void put(size_t row, size_t column, std::string_view text);
+
+	// Writes the difference to the terminal and returns the number of bytes sent.
+	size_t present();
+	void   invalidate();
+
+	// Switch to and from the alternate screen with the cursor hidden.
+	void enter();
+	void leave();
+
+private:
+	void move_cursor(size_t row, size_t column);
+	void write_frame();
+
+	std::vector<char> m_front;
+	std::vector<char> m_back;
+	std::string		  m_frame;
+
+	size_t m_rows		   = 0;
+	size_t m_columns	   = 0;
+	size_t m_cursor_row	   = 0;
+	size_t m_cursor_column = 0;
+	bool   m_full_redraw   = true;
+};
+
+} // namespace UTILS
+
+#endif // TERMINAL_SCREEN_HPP
@@ -0,0 +1,194 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+namespace
+{
+constexpr uint64_t pack(uint32_t begin, uint32_t end)
+{
+	return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+constexpr uint32_t range_begin(uint64_t bounds)
+{
+	return static_cast<uint32_t>(bounds >> 32);
+}
+
+constexpr uint32_t range_end(uint64_t bounds)
+{
+	return static_cast<uint32_t>(bounds);
+}
+} // namespace
+
+namespace UTILS
+{
+
+WorkStealingPool::WorkStealingPool(size_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	m_participants = thread_count;
+	m_ranges	   = std::make_unique<ChunkRange[]>(m_participants);
+
+	// Participant 0 is whoever calls parallel_for().
+	for (size_t i = 1; i < m_participants; ++i)
+	{
+		m_threads.emplace_back(&WorkStealingPool::worker_loop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_state_mutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+size_t WorkStealingPool::thread_count() const
+{
+	return m_participants;
+}
+
+void WorkStealingPool::parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> job_lock(m_job_mutex);
+
+	// Chunk indices are packed into 32 bits; grow the chunks for absurdly large jobs.
+	chunk_size			= std::max({chunk_size, size_t {1}, (count + UINT32_MAX - 1) / UINT32_MAX});
+	const size_t chunks = (count + chunk_size - 1) / chunk_size;
+
+	m_body		 = &body;
+	m_count		 = count;
+	m_chunk_size = chunk_size;
+	m_remaining.store(chunks, std::memory_order_relaxed);
+
+	// Deal contiguous runs so neighbouring chunks (and their cache lines) stay on one thread.
+	for (size_t i = 0; i < m_participants; ++i)
+	{
+		uint32_t begin = static_cast<uint32_t>(chunks * i / m_participants);
+		uint32_t end   = static_cast<uint32_t>(chunks * (i + 1) / m_participants);
+		m_ranges[i].bounds.store(pack(begin, end), std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_state_mutex);
+		m_active.store(m_participants - 1, std::memory_order_relaxed);
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	this->run_participant(0);
+
+	std::unique_lock<std::mutex> lock(m_state_mutex);
+	m_done.wait(lock, [this] { return m_active.load(std::memory_order_acquire) == 0; });
+	m_body = nullptr;
+}
+
+void WorkStealingPool::worker_loop(size_t index)
+{
+	uint64_t seen_generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_state_mutex);
+			m_wake.wait(lock, [&] { return m_stopping || m_generation != seen_generation; });
+
+			if (m_stopping)
+			{
+				return;
+			}
+
+			seen_generation = m_generation;
+		}
+
+		this->run_participant(index);
+
+		if (m_active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(m_state_mutex);
+			m_done.notify_all();
+		}
+	}
+}
+
+void WorkStealingPool::run_participant(size_t index)
+{
+	while (m_remaining.load(std::memory_order_acquire) > 0)
+	{
+		uint32_t chunk;
+		if (!this->take_chunk(index, chunk))
+		{
+			if (!this->steal_chunks(index))
+			{
+				std::this_thread::yield();
+			}
+			continue;
+		}
+
+		size_t begin = static_cast<size_t>(chunk) * m_chunk_size;
+		size_t end	 = std::min(begin + m_chunk_size, m_count);
+		(*m_body)(begin, end);
+
+		m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+
+bool WorkStealingPool::take_chunk(size_t index, uint32_t& chunk)
+{
+	std::atomic<uint64_t>& bounds  = m_ranges[index].bounds;
+	uint64_t			   current = bounds.load(std::memory_order_acquire);
+
+	while (range_begin(current) < range_end(current))
+	{
+		if (bounds.compare_exchange_weak(current, pack(range_begin(current) + 1, range_end(current)), std::memory_order_acq_rel))
+		{
+			chunk = range_begin(current);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool WorkStealingPool::steal_chunks(size_t thief)
+{
+	for (size_t step = 1; step < m_participants; ++step)
+	{
+		std::atomic<uint64_t>& victim  = m_ranges[(thief + step) % m_participants].bounds;
+		uint64_t			   current = victim.load(std::memory_order_acquire);
+
+		while (range_begin(current) < range_end(current))
+		{
+			uint32_t begin	= range_begin(current);
+			uint32_t end	= range_end(current);
+			uint32_t middle = end - (end - begin + 1) / 2;
+
+			if (victim.compare_exchange_weak(current, pack(begin, middle), std::memory_order_acq_rel))
+			{
+				// Our own run is empty, so nobody else will touch it until we publish the stolen half.
+				m_ranges[thief].bounds.store(pack(middle, end), std::memory_order_release);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+} // namespace UTILS
@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace UTILS
+{
+// Fixed set of worker threads that split index ranges with work stealing.
+//
+// parallel_for() cuts [0, count) into chunks and deals each participant (the workers plus the
+// calling thread) a contiguous run of them. A participant takes chunks from the front of its own
+// run; once it runs dry it steals the back half of the fullest-looking victim's run. Runs are packed
+// (begin, end) pairs in one atomic word, so both operations are a single CAS and no task objects are
+// allocated.
+class WorkStealingPool
+{
+public:
+	// thread_count includes the calling thread; 0 picks the host's hardware concurrency.
+	explicit WorkStealingPool(size_t thread_count = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&)			 = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	size_t thread_count() const;
+
+	// Calls body(begin, end) for consecutive item ranges of at most chunk_size items covering
+	// [0, count), then returns once every range has finished. One call runs at a time.
+	void parallel_for(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& body);
+
+private:
+	struct alignas(64) ChunkRange
+	{
+		std::atomic<uint64_t> bounds = 0;
+	};
+
+	void worker_loop(size_t index);
+	void run_participant(size_t index);
+	bool take_chunk(size_t index, uint32_t& chunk);
+	bool steal_chunks(size_t thief);
+
+	std::vector<std::thread>				 m_threads;
+	std::unique_ptr<ChunkRange[]>			 m_ranges;
+	size_t									 m_participants = 1;
+
+	// State of the job being run; written by parallel_for() before the generation bump.
+	const std::function<void(size_t, size_t)>* m_body		 = nullptr;
+	size_t									   m_count		 = 0;
+	size_t									   m_chunk_size = 1;
+	std::atomic<size_t>						   m_remaining	 = 0;
+	std::atomic<size_t>						   m_active		 = 0;
+
+	std::mutex				m_job_mutex;
+	std::mutex				m_state_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t				m_generation = 0;
+	bool					m_stopping	 = false;
+};
+
+} // namespace UTILS
+
+#endif // THREAD_POOL_HPP
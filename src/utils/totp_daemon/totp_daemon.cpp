@@ -0,0 +1,751 @@
+#include "totp_daemon.hpp"
+
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr size_t d_max_request_fields = 4;
+constexpr int	 d_max_epoll_events	  = 64;
+
+// How often an empty code table is refreshed, since no rollover is due.
+constexpr uint64_t d_code_table_idle_interval = 60;
+
+// Splits on tabs; returns the field count, or d_max_request_fields + 1 if there are too many.
+size_t split_fields(std::string_view line, std::string_view (&fields)[d_max_request_fields])
+{
+	size_t count = 0;
+
+	while (true)
+	{
+		if (count == d_max_request_fields)
+		{
+			return count + 1;
+		}
+
+		size_t end		= line.find('\t');
+		fields[count++] = line.substr(0, end);
+
+		if (end == std::string_view::npos)
+		{
+			return count;
+		}
+
+		line.remove_prefix(end + 1);
+	}
+}
+
+#ifndef _WIN32
+bool make_address(const fs::path& socket_path, sockaddr_un& address)
+{
+	address			   = {};
+	address.sun_family = AF_UNIX;
+
+	const std::string& path = socket_path.native();
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		return false;
+	}
+
+	std::copy(path.begin(), path.end(), address.sun_path);
+	return true;
+}
+#endif
+} // namespace
+
+namespace UTILS
+{
+
+TOTPDaemon::TOTPDaemon(std::shared_ptr<TOTPManager> totp_manager)
+	: m_totp_manager(std::move(totp_manager))
+{}
+
+void TOTPDaemon::publish_codes(const fs::path& table_path)
+{
+	m_code_table_path = table_path;
+}
+
+void TOTPDaemon::handle_request(std::string_view line, std::string& output) const
+{
+	std::string_view fields[d_max_request_fields];
+	const size_t	 count	   = split_fields(line, fields);
+	const uint64_t	 unix_time = static_cast<uint64_t>(time(NULL));
+
+	if (fields[0] == "GENERATE" && count <= 2)
+	{
+		std::string account = count == 2 ? std::string(fields[1]) : m_totp_manager->get_account_name();
+
+		char   code[d_max_code_digits];
+		size_t size = account.empty() ? 0 : m_totp_manager->generate_totp(account, unix_time, code);
+		if (size == 0)
+		{
+			output.append("ERR\tunknown account\n");
+			return;
+		}
+
+		fmt::format_to(std::back_inserter(output), "OK\t{}\t{}\n", account, std::string_view(code, size));
+	}
+	else if (fields[0] == "VERIFY" && (count == 3 || count == 4))
+	{
+		uint32_t window = 1;
+		if (count == 4)
+		{
+			auto [end, error] = std::from_chars(fields[3].data(), fields[3].data() + fields[3].size(), window);
+			if (error != std::errc() || end != fields[3].data() + fields[3].size())
+			{
+				output.append("ERR\tmalformed window\n");
+				return;
+			}
+		}
+
+		std::optional<int32_t> offset = m_totp_manager->verify(fields[1], fields[2], unix_time, window);
+		if (!offset)
+		{
+			output.append("ERR\trejected\n");
+			return;
+		}
+
+		fmt::format_to(std::back_inserter(output), "OK\t{}\n", *offset);
+	}
+	else if (fields[0] == "LIST" && count == 1)
+	{
+		std::vector<std::string> names = m_totp_manager->get_account_names();
+
+		fmt::format_to(std::back_inserter(output), "OK\t{}\n", names.size());
+		for (const std::string& name : names)
+		{
+			char   code[d_max_code_digits];
+			size_t size = m_totp_manager->generate_totp(name, unix_time, code);
+			fmt::format_to(std::back_inserter(output), "{}\t{}\n", name, std::string_view(code, size));
+		}
+	}
+	else
+	{
+		output.append("ERR\tmalformed request\n");
+	}
+}
+
+void TOTPDaemon::handle_frame(const TOTPCLIENT::RequestFrame& request, TOTPCLIENT::ReplyFrame& reply) const
+{
+	using TOTPCLIENT::ReplyStatus;
+	using TOTPCLIENT::RequestType;
+
+	reply		   = TOTPCLIENT::ReplyFrame {};
+	reply.type	   = request.type;
+	reply.sequence = request.sequence;
+
+	if (request.version != TOTPCLIENT::d_protocol_version)
+	{
+		return;
+	}
+
+	// Clients may pick the time of a GENERATE, never of a VERIFY: accepting a captured code at its old
+	// time would also record it over the replay cache entries of the step sharing its ring bucket.
+	if (request.type == RequestType::VERIFY && request.unix_time != 0)
+	{
+		return;
+	}
+
+	const uint64_t unix_time = request.unix_time != 0 ? request.unix_time : static_cast<uint64_t>(time(NULL));
+
+	std::string		 current_account;
+	std::string_view account = TOTPCLIENT::request_account(request);
+	if (account.empty())
+	{
+		current_account = m_totp_manager->get_account_name();
+		account			= current_account;
+	}
+
+	std::optional<AccountParameters> parameters = m_totp_manager->get_account_parameters(account);
+	if (!parameters)
+	{
+		reply.status = ReplyStatus::UNKNOWN_ACCOUNT;
+		return;
+	}
+
+	if (request.type == RequestType::GENERATE)
+	{
+		std::optional<uint32_t> code = m_totp_manager->generate_code(account, unix_time);
+		if (!code)
+		{
+			reply.status = ReplyStatus::UNKNOWN_ACCOUNT;
+			return;
+		}
+
+		reply.status	  = ReplyStatus::OK;
+		reply.code		  = *code;
+		reply.digits	  = static_cast<uint8_t>(parameters->digits);
+		reply.valid_until = (unix_time / parameters->period + 1) * parameters->period;
+	}
+	else if (request.type == RequestType::VERIFY)
+	{
+		std::optional<int32_t> offset = m_totp_manager->verify(account, TOTPCLIENT::request_code(request), unix_time, request.window);
+		if (!offset)
+		{
+			reply.status = ReplyStatus::REJECTED;
+			return;
+		}
+
+		reply.status = ReplyStatus::OK;
+		reply.offset = *offset;
+	}
+}
+
+bool TOTPDaemon::process_text(Connection& connection) const
+{
+	size_t consumed = 0;
+	for (size_t end = connection.input.find('\n'); end != std::string::npos && connection.output.size() < d_daemon_max_output_size;
+		 end		= connection.input.find('\n', consumed))
+	{
+		std::string_view line(connection.input.data() + consumed, end - consumed);
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.remove_suffix(1);
+		}
+
+		this->handle_request(line, connection.output);
+		consumed = end + 1;
+	}
+	connection.input.erase(0, consumed);
+
+	// Lines left over for back-pressure are complete; only an unterminated one can be too long.
+	return connection.output.size() >= d_daemon_max_output_size || connection.input.size() <= d_daemon_max_line_size;
+}
+
+bool TOTPDaemon::process_frames(Connection& connection) const
+{
+	// Frames past the output cap wait in the input until the client has read enough replies.
+	const size_t room	= connection.output.size() < d_daemon_max_output_size
+							  ? (d_daemon_max_output_size - connection.output.size()) / sizeof(TOTPCLIENT::ReplyFrame)
+							  : 0;
+	const size_t frames = std::min(connection.input.size() / sizeof(TOTPCLIENT::RequestFrame), room);
+
+	// Replies are written straight into the output buffer, one fixed-size slot per request.
+	const size_t reply_offset = connection.output.size();
+	connection.output.resize(reply_offset + frames * sizeof(TOTPCLIENT::ReplyFrame));
+
+	for (size_t i = 0; i < frames; ++i)
+	{
+		TOTPCLIENT::RequestFrame request;
+		std::memcpy(&request, connection.input.data() + i * sizeof(request), sizeof(request));
+
+		if (request.magic != TOTPCLIENT::d_protocol_magic)
+		{
+			// Lost framing; drop the connection rather than guess where the next frame starts. The replies
+			// already written still go out, but not the empty slots reserved for the rest.
+			connection.output.resize(reply_offset + i * sizeof(TOTPCLIENT::ReplyFrame));
+			return false;
+		}
+
+		TOTPCLIENT::ReplyFrame reply;
+		this->handle_frame(request, reply);
+		std::memcpy(connection.output.data() + reply_offset + i * sizeof(reply), &reply, sizeof(reply));
+	}
+
+	connection.input.erase(0, frames * sizeof(TOTPCLIENT::RequestFrame));
+	return true;
+}
+
+#ifdef _WIN32
+
+TOTPDaemon::~TOTPDaemon()
+{}
+
+bool TOTPDaemon::listen(const fs::path&)
+{
+	SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "Daemon mode is not supported on this platform.");
+	return false;
+}
+
+bool TOTPDaemon::run()
+{
+	return false;
+}
+
+void TOTPDaemon::accept_connections()
+{}
+
+bool TOTPDaemon::read_connection(int, Connection&)
+{
+	return false;
+}
+
+bool TOTPDaemon::flush_connection(int, Connection&)
+{
+	return false;
+}
+
+void TOTPDaemon::close_connection(int)
+{}
+
+void TOTPDaemon::republish_codes(int)
+{}
+
+DaemonClient::~DaemonClient()
+{}
+
+bool DaemonClient::connect(const fs::path&)
+{
+	return false;
+}
+
+std::optional<std::string> DaemonClient::request(std::string_view)
+{
+	return std::nullopt;
+}
+
+std::optional<std::string> DaemonClient::read_line()
+{
+	return std::nullopt;
+}
+
+#else
+
+TOTPDaemon::~TOTPDaemon()
+{
+	for (auto& [fd, connection] : m_connections)
+	{
+		close(fd);
+	}
+
+	if (m_epoll_fd >= 0)
+	{
+		close(m_epoll_fd);
+	}
+
+	if (m_listen_fd >= 0)
+	{
+		close(m_listen_fd);
+		unlink(m_socket_path.c_str());
+	}
+}
+
+bool TOTPDaemon::listen(const fs::path& socket_path)
+{
+	sockaddr_un address;
+	if (!make_address(socket_path, address))
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Daemon socket path '{}' is too long.", socket_path.string()));
+		return false;
+	}
+
+	// A socket file nobody answers on is left over from a crash; a live one belongs to a running daemon.
+	DaemonClient probe;
+	if (probe.connect(socket_path))
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("A daemon is already listening on '{}'.", socket_path.string()));
+		return false;
+	}
+	unlink(socket_path.c_str());
+
+	m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (m_listen_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create daemon socket: {}", strerror(errno)));
+		return false;
+	}
+
+	// Only the owning user may connect.
+	mode_t previous_mask = umask(0177);
+	int	   bound		 = bind(m_listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+	umask(previous_mask);
+
+	if (bound < 0 || ::listen(m_listen_fd, SOMAXCONN) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to listen on '{}': {}", socket_path.string(), strerror(errno)));
+		close(m_listen_fd);
+		m_listen_fd = -1;
+		return false;
+	}
+
+	m_socket_path = socket_path;
+	SPD_INFO_CLASS(COMMON::d_settings_group_utils, fmt::format("Daemon listening on '{}'.", socket_path.string()));
+	return true;
+}
+
+bool TOTPDaemon::run()
+{
+	if (m_listen_fd < 0)
+	{
+		return false;
+	}
+
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	m_epoll_fd	  = epoll_create1(EPOLL_CLOEXEC);
+	if (signal_fd < 0 || m_epoll_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to set up the daemon event loop: {}", strerror(errno)));
+		if (signal_fd >= 0)
+		{
+			close(signal_fd);
+		}
+		return false;
+	}
+
+	int timer_fd = -1;
+	if (!m_code_table_path.empty() && m_code_table.open(m_code_table_path))
+	{
+		timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	}
+
+	for (int fd : {m_listen_fd, signal_fd, timer_fd})
+	{
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		epoll_event event = {};
+		event.events	  = EPOLLIN;
+		event.data.fd	  = fd;
+		epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+	}
+
+	if (timer_fd >= 0)
+	{
+		this->republish_codes(timer_fd);
+	}
+
+	bool		running = true;
+	bool		healthy = true;
+	epoll_event events[d_max_epoll_events];
+
+	while (running)
+	{
+		int ready = epoll_wait(m_epoll_fd, events, d_max_epoll_events, -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Daemon event loop failed: {}", strerror(errno)));
+			healthy = false;
+			break;
+		}
+
+		for (int i = 0; i < ready; ++i)
+		{
+			const int fd = events[i].data.fd;
+
+			if (fd == m_listen_fd)
+			{
+				this->accept_connections();
+				continue;
+			}
+
+			if (fd == signal_fd)
+			{
+				// Consume the signal so it does not stay pending for whoever runs next in this process.
+				signalfd_siginfo info;
+				[[maybe_unused]] ssize_t size = read(signal_fd, &info, sizeof(info));
+				running						  = false;
+				continue;
+			}
+
+			if (fd == timer_fd)
+			{
+				// Expiry count, or ECANCELED after a clock change; either way the table is rebuilt from now.
+				uint64_t				 expirations;
+				[[maybe_unused]] ssize_t size = read(timer_fd, &expirations, sizeof(expirations));
+				this->republish_codes(timer_fd);
+				continue;
+			}
+
+			auto connection = m_connections.find(fd);
+			if (connection == m_connections.end())
+			{
+				continue;
+			}
+
+			// Answer whatever arrived before a hang-up, then drop the connection. Draining replies may make
+			// room to answer requests held back by the output cap, so writability reads as well.
+			bool open = this->flush_connection(fd, connection->second);
+			if (open && (events[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR | EPOLLRDHUP)))
+			{
+				open = this->read_connection(fd, connection->second);
+			}
+
+			if (!this->flush_connection(fd, connection->second) || !open)
+			{
+				this->close_connection(fd);
+			}
+		}
+	}
+
+	if (timer_fd >= 0)
+	{
+		close(timer_fd);
+	}
+	m_code_table.close();
+
+	close(signal_fd);
+	SPD_INFO_CLASS(COMMON::d_settings_group_utils, "Daemon stopped.");
+	return healthy;
+}
+
+void TOTPDaemon::accept_connections()
+{
+	while (true)
+	{
+		int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			{
+				SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to accept a daemon client: {}", strerror(errno)));
+			}
+			return;
+		}
+
+		epoll_event event = {};
+		event.events	  = EPOLLIN | EPOLLRDHUP;
+		event.data.fd	  = fd;
+		if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+		{
+			close(fd);
+			continue;
+		}
+
+		m_connections.try_emplace(fd);
+	}
+}
+
+bool TOTPDaemon::read_connection(int fd, Connection& connection)
+{
+	char buffer[4096];
+
+	// Requests are answered as they arrive. Once unread replies reach d_daemon_max_output_size the rest
+	// stays in the socket, so a client that never reads cannot grow the daemon's buffers.
+	while (true)
+	{
+		if (connection.protocol == Protocol::UNKNOWN && !connection.input.empty())
+		{
+			// The binary magic starts with a non-ASCII byte, so one byte settles it.
+			char magic_first;
+			std::memcpy(&magic_first, &TOTPCLIENT::d_protocol_magic, 1);
+			connection.protocol = connection.input[0] == magic_first ? Protocol::BINARY : Protocol::TEXT;
+		}
+
+		const bool valid = connection.protocol == Protocol::BINARY ? this->process_frames(connection) : this->process_text(connection);
+		if (!valid)
+		{
+			return false;
+		}
+
+		if (connection.output.size() >= d_daemon_max_output_size)
+		{
+			return true;
+		}
+
+		ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+		if (size > 0)
+		{
+			connection.input.append(buffer, static_cast<size_t>(size));
+			continue;
+		}
+
+		if (size < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		return size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+}
+
+bool TOTPDaemon::flush_connection(int fd, Connection& connection)
+{
+	size_t sent = 0;
+
+	while (sent < connection.output.size())
+	{
+		ssize_t size = send(fd, connection.output.data() + sent, connection.output.size() - sent, MSG_NOSIGNAL);
+		if (size < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			break;
+		}
+
+		sent += static_cast<size_t>(size);
+	}
+
+	connection.output.erase(0, sent);
+
+	// Only ask for writability while a reply is backed up, so idle clients cost no wakeups, and stop
+	// asking for requests while too many replies are, as the HTTP server does.
+	const bool reading			 = connection.output.size() < d_daemon_max_output_size;
+	const bool waiting_for_write = !connection.output.empty();
+	if (reading != connection.reading || waiting_for_write != connection.waiting_for_write)
+	{
+		epoll_event event = {};
+		event.events	  = (reading ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u) | (waiting_for_write ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+		event.data.fd	  = fd;
+		epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+
+		connection.reading			 = reading;
+		connection.waiting_for_write = waiting_for_write;
+	}
+
+	return true;
+}
+
+void TOTPDaemon::close_connection(int fd)
+{
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	close(fd);
+	m_connections.erase(fd);
+}
+
+void TOTPDaemon::republish_codes(int timer_fd)
+{
+	const uint64_t unix_time = static_cast<uint64_t>(time(NULL));
+	m_code_table.publish(*m_totp_manager, unix_time);
+
+	// Entries also carry the next step's code, so publishing at each rollover keeps readers a step ahead.
+	std::optional<uint64_t> rollover = m_totp_manager->precompute_codes(unix_time);
+
+	itimerspec expiry	   = {};
+	expiry.it_value.tv_sec = static_cast<time_t>(rollover.value_or(unix_time + d_code_table_idle_interval));
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &expiry, nullptr);
+}
+
+DaemonClient::~DaemonClient()
+{
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+}
+
+bool DaemonClient::connect(const fs::path& socket_path)
+{
+	sockaddr_un address;
+	if (!make_address(socket_path, address))
+	{
+		return false;
+	}
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	// A wedged daemon must not hang the CLI; it falls back to computing the code itself.
+	timeval timeout = {1, 0};
+	setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(m_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	bool connected = ::connect(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+#ifdef __linux__
+	// The /tmp fallback path is predictable, so only trust a daemon run by the same user.
+	ucred	  credentials = {};
+	socklen_t length	  = sizeof(credentials);
+	connected			  = connected && getsockopt(m_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == getuid();
+#endif
+
+	if (!connected)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+
+	return connected;
+}
+
+std::optional<std::string> DaemonClient::request(std::string_view line)
+{
+	if (m_fd < 0)
+	{
+		return std::nullopt;
+	}
+
+	std::string message(line);
+	message.push_back('\n');
+
+	size_t sent = 0;
+	while (sent < message.size())
+	{
+		ssize_t size = send(m_fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+		if (size < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return std::nullopt;
+		}
+
+		sent += static_cast<size_t>(size);
+	}
+
+	return this->read_line();
+}
+
+std::optional<std::string> DaemonClient::read_line()
+{
+	while (true)
+	{
+		size_t end = m_buffer.find('\n');
+		if (end != std::string::npos)
+		{
+			std::string line = m_buffer.substr(0, end);
+			m_buffer.erase(0, end + 1);
+			return line;
+		}
+
+		char	buffer[4096];
+		ssize_t size = recv(m_fd, buffer, sizeof(buffer), 0);
+		if (size < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (size <= 0)
+		{
+			return std::nullopt;
+		}
+
+		m_buffer.append(buffer, static_cast<size_t>(size));
+	}
+}
+
+#endif
+
+} // namespace UTILS
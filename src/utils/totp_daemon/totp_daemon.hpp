@@ -0,0 +1,119 @@
+#ifndef TOTP_DAEMON_HPP
+#define TOTP_DAEMON_HPP
+
+#include "code_table_publisher.hpp"
+#include "totp_manager.hpp"
+#include "totp_protocol.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace UTILS
+{
+// Longest request line a client may send before the daemon drops the connection.
+constexpr size_t d_daemon_max_line_size = 4096;
+
+// Unread replies a client may leave queued before the daemon stops reading its requests.
+constexpr size_t d_daemon_max_output_size = 65536;
+
+// Serves codes from a warm TOTPManager over an AF_UNIX stream socket.
+//
+// Requests and replies are tab-separated lines:
+//   GENERATE[\t<account>]			   -> OK\t<account>\t<code>
+//   VERIFY\t<account>\t<code>[\t<window>] -> OK\t<offset>
+//   LIST							   -> OK\t<count>, then <count> lines of <account>\t<code>
+// Failures reply ERR\t<reason>. A client may pipeline any number of requests on one connection; the daemon
+// stops reading them while d_daemon_max_output_size bytes of replies are waiting to be read.
+// A connection whose first bytes are the binary protocol magic speaks fixed-size frames instead
+// (see totp_protocol.hpp); each frame is decoded and answered without parsing or allocations.
+// All sockets are non-blocking and multiplexed by one epoll loop; SIGINT and SIGTERM end it.
+class TOTPDaemon
+{
+public:
+	explicit TOTPDaemon(std::shared_ptr<TOTPManager> totp_manager);
+	~TOTPDaemon();
+
+	TOTPDaemon(const TOTPDaemon&)			 = delete;
+	TOTPDaemon& operator=(const TOTPDaemon&) = delete;
+
+	// Binds the socket, replacing a stale one but refusing if another daemon answers on it.
+	bool listen(const fs::path& socket_path);
+
+	// Also keeps a shared-memory code table (see code_table.hpp) current while run() is serving,
+	// republishing at every rollover.
+	void publish_codes(const fs::path& table_path);
+
+	// Runs the event loop until a termination signal arrives. Returns false on a fatal error.
+	bool run();
+
+private:
+	enum class Protocol : uint8_t
+	{
+		UNKNOWN,
+		TEXT,
+		BINARY
+	};
+
+	struct Connection
+	{
+		std::string input;
+		std::string output;
+		Protocol	protocol		  = Protocol::UNKNOWN;
+		bool		reading			  = true;
+		bool		waiting_for_write = false;
+	};
+
+	void accept_connections();
+	bool read_connection(int fd, Connection& connection);
+	bool flush_connection(int fd, Connection& connection);
+	void close_connection(int fd);
+	void republish_codes(int timer_fd);
+
+	bool process_text(Connection& connection) const;
+	bool process_frames(Connection& connection) const;
+
+	void handle_request(std::string_view line, std::string& output) const;
+	void handle_frame(const TOTPCLIENT::RequestFrame& request, TOTPCLIENT::ReplyFrame& reply) const;
+
+	std::shared_ptr<TOTPManager>		m_totp_manager;
+	std::unordered_map<int, Connection> m_connections;
+	fs::path							m_socket_path;
+	fs::path							m_code_table_path;
+	CodeTablePublisher					m_code_table;
+
+	int m_listen_fd = -1;
+	int m_epoll_fd	= -1;
+};
+
+// Blocking client for the daemon's line protocol, used by the CLI to skip its own start-up.
+class DaemonClient
+{
+public:
+	DaemonClient() = default;
+	~DaemonClient();
+
+	DaemonClient(const DaemonClient&)			 = delete;
+	DaemonClient& operator=(const DaemonClient&) = delete;
+
+	bool connect(const fs::path& socket_path);
+
+	// Sends one request line (without the newline) and returns the first reply line.
+	std::optional<std::string> request(std::string_view line);
+
+	// Reads a further reply line, for replies that span several (LIST).
+	std::optional<std::string> read_line();
+
+private:
+	int			m_fd = -1;
+	std::string m_buffer;
+};
+
+} // namespace UTILS
+
+#endif // TOTP_DAEMON_HPP
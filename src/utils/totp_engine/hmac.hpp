@@ -0,0 +1,102 @@
+#ifndef HMAC_HPP
+#define HMAC_HPP
+
+#include "sha.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace UTILS
+{
+// Chaining state after absorbing the HMAC (key ^ ipad) and (key ^ opad) blocks.
+// Keeping both lets every code be produced with only the two remaining compressions.
+template<typename Hash>
+struct HmacKey
+{
+	typename Hash::state_type inner = {};
+	typename Hash::state_type outer = {};
+};
+
+template<typename Hash>
+constexpr HmacKey<Hash> make_hmac_key(std::span<const uint8_t> key)
+{
+	uint8_t block[Hash::block_size] = {};
+
+	if (key.size() > Hash::block_size)
+	{
+		sha_digest<Hash>(key, block);
+	}
+	else if (!key.empty())
+	{
+		std::copy(key.begin(), key.end(), block);
+	}
+
+	HmacKey<Hash> result;
+	uint8_t		  pad[Hash::block_size] = {};
+
+	for (size_t i = 0; i < Hash::block_size; ++i)
+	{
+		pad[i] = block[i] ^ 0x36;
+	}
+	result.inner = Hash::initial_state;
+	Hash::compress(result.inner, pad);
+
+	for (size_t i = 0; i < Hash::block_size; ++i)
+	{
+		pad[i] = block[i] ^ 0x5C;
+	}
+	result.outer = Hash::initial_state;
+	Hash::compress(result.outer, pad);
+
+	return result;
+}
+
+// Padded inner and outer message blocks for counter HMACs. Between codes under one key only the
+// counter bytes and the inner digest change, so a run of codes formats the padding and length
+// fields once and rewrites just those bytes per code.
+template<typename Hash>
+struct HmacCounterBlocks
+{
+	uint8_t inner[Hash::block_size] = {};
+	uint8_t outer[Hash::block_size] = {};
+
+	constexpr HmacCounterBlocks()
+	{
+		// Inner message is the counter after the (key ^ ipad) block.
+		inner[8] = 0x80;
+		sha_store_length<Hash>(inner, Hash::block_size + 8);
+
+		// Outer message is the inner digest after the (key ^ opad) block.
+		outer[Hash::digest_size] = 0x80;
+		sha_store_length<Hash>(outer, Hash::block_size + Hash::digest_size);
+	}
+
+	constexpr void digest(const HmacKey<Hash>& key, uint64_t counter, std::span<uint8_t, Hash::digest_size> digest)
+	{
+		store_be64(inner, counter);
+
+		typename Hash::state_type inner_state = key.inner;
+		Hash::compress(inner_state, inner);
+
+		sha_store_digest<Hash>(inner_state, outer);
+
+		typename Hash::state_type outer_state = key.outer;
+		Hash::compress(outer_state, outer);
+
+		sha_store_digest<Hash>(outer_state, digest.data());
+	}
+};
+
+// HMAC of the 8-byte big-endian counter used by HOTP/TOTP.
+template<typename Hash>
+constexpr void hmac_counter(const HmacKey<Hash>& key, uint64_t counter, std::span<uint8_t, Hash::digest_size> digest)
+{
+	HmacCounterBlocks<Hash> blocks;
+	blocks.digest(key, counter, digest);
+}
+
+} // namespace UTILS
+
+#endif // HMAC_HPP
@@ -0,0 +1,102 @@
+#include "sha.hpp"
+
+#include "sha_ni.hpp"
+
+#include <atomic>
+
+namespace
+{
+// Hashes a fixed block through both paths and requires identical chaining states.
+template<typename Hash>
+bool matches_portable(void (*portable)(typename Hash::state_type &, const uint8_t *), void (*candidate)(typename Hash::state_type &, const uint8_t *))
+{
+	uint8_t block[Hash::block_size];
+	for (size_t i = 0; i < sizeof(block); ++i)
+	{
+		block[i] = static_cast<uint8_t>(i * 37 + 11);
+	}
+
+	typename Hash::state_type expected = Hash::initial_state;
+	typename Hash::state_type actual   = Hash::initial_state;
+
+	for (size_t round = 0; round < 3; ++round)
+	{
+		portable(expected, block);
+		candidate(actual, block);
+	}
+
+	return expected == actual;
+}
+
+UTILS::ShaImplementation detect_sha_implementation()
+{
+	if (UTILS::sha_ni_supported() && matches_portable<UTILS::Sha1>(UTILS::Sha1::compress_portable, UTILS::sha1_compress_sha_ni) &&
+		matches_portable<UTILS::Sha256>(UTILS::Sha256::compress_portable, UTILS::sha256_compress_sha_ni))
+	{
+		return UTILS::ShaImplementation::SHA_NI;
+	}
+
+	return UTILS::ShaImplementation::PORTABLE;
+}
+
+using Sha1CompressFunction	 = void (*)(UTILS::Sha1::state_type &, const uint8_t *);
+using Sha256CompressFunction = void (*)(UTILS::Sha256::state_type &, const uint8_t *);
+
+void sha1_compress_resolve(UTILS::Sha1::state_type& state, const uint8_t* block);
+void sha256_compress_resolve(UTILS::Sha256::state_type& state, const uint8_t* block);
+
+// Both pointers start at a resolver that picks the implementation on the first call and then
+// replaces itself, so steady-state hashing is a single indirect call.
+std::atomic<Sha1CompressFunction>	g_sha1_compress	  = sha1_compress_resolve;
+std::atomic<Sha256CompressFunction> g_sha256_compress = sha256_compress_resolve;
+
+void sha1_compress_resolve(UTILS::Sha1::state_type& state, const uint8_t* block)
+{
+	Sha1CompressFunction function =
+		UTILS::sha_implementation() == UTILS::ShaImplementation::SHA_NI ? UTILS::sha1_compress_sha_ni : UTILS::Sha1::compress_portable;
+	g_sha1_compress.store(function, std::memory_order_relaxed);
+	function(state, block);
+}
+
+void sha256_compress_resolve(UTILS::Sha256::state_type& state, const uint8_t* block)
+{
+	Sha256CompressFunction function =
+		UTILS::sha_implementation() == UTILS::ShaImplementation::SHA_NI ? UTILS::sha256_compress_sha_ni : UTILS::Sha256::compress_portable;
+	g_sha256_compress.store(function, std::memory_order_relaxed);
+	function(state, block);
+}
+} // namespace
+
+namespace UTILS
+{
+
+ShaImplementation sha_implementation()
+{
+	static const ShaImplementation implementation = detect_sha_implementation();
+	return implementation;
+}
+
+std::string_view sha_implementation_to_string(ShaImplementation implementation)
+{
+	switch (implementation)
+	{
+		case ShaImplementation::SHA_NI:
+			return "SHA-NI";
+		case ShaImplementation::PORTABLE:
+			return "Portable";
+	}
+
+	return "Unknown";
+}
+
+void Sha1::compress_runtime(state_type& state, const uint8_t* block)
+{
+	g_sha1_compress.load(std::memory_order_relaxed)(state, block);
+}
+
+void Sha256::compress_runtime(state_type& state, const uint8_t* block)
+{
+	g_sha256_compress.load(std::memory_order_relaxed)(state, block);
+}
+
+} // namespace UTILS
@@ -0,0 +1,382 @@
+#ifndef SHA_HPP
+#define SHA_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace UTILS
+{
+constexpr uint32_t load_be32(const uint8_t* bytes)
+{
+	return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) |
+		   static_cast<uint32_t>(bytes[3]);
+}
+
+constexpr uint64_t load_be64(const uint8_t* bytes)
+{
+	return (static_cast<uint64_t>(load_be32(bytes)) << 32) | load_be32(bytes + 4);
+}
+
+constexpr void store_be32(uint8_t* bytes, uint32_t value)
+{
+	bytes[0] = static_cast<uint8_t>(value >> 24);
+	bytes[1] = static_cast<uint8_t>(value >> 16);
+	bytes[2] = static_cast<uint8_t>(value >> 8);
+	bytes[3] = static_cast<uint8_t>(value);
+}
+
+constexpr void store_be64(uint8_t* bytes, uint64_t value)
+{
+	store_be32(bytes, static_cast<uint32_t>(value >> 32));
+	store_be32(bytes + 4, static_cast<uint32_t>(value));
+}
+
+inline constexpr uint32_t d_sha256_round_constants[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5, 0xD807AA98, 0x12835B01, 0x243185BE,
+	0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174, 0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA,
+	0x5CB0A9DC, 0x76F988DA, 0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967, 0x27B70A85,
+	0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85, 0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+	0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070, 0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F,
+	0x682E6FF3, 0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2};
+
+inline constexpr uint64_t d_sha512_round_constants[80] = {
+	0x428A2F98D728AE22, 0x7137449123EF65CD, 0xB5C0FBCFEC4D3B2F, 0xE9B5DBA58189DBBC, 0x3956C25BF348B538, 0x59F111F1B605D019, 0x923F82A4AF194F9B,
+	0xAB1C5ED5DA6D8118, 0xD807AA98A3030242, 0x12835B0145706FBE, 0x243185BE4EE4B28C, 0x550C7DC3D5FFB4E2, 0x72BE5D74F27B896F, 0x80DEB1FE3B1696B1,
+	0x9BDC06A725C71235, 0xC19BF174CF692694, 0xE49B69C19EF14AD2, 0xEFBE4786384F25E3, 0x0FC19DC68B8CD5B5, 0x240CA1CC77AC9C65, 0x2DE92C6F592B0275,
+	0x4A7484AA6EA6E483, 0x5CB0A9DCBD41FBD4, 0x76F988DA831153B5, 0x983E5152EE66DFAB, 0xA831C66D2DB43210, 0xB00327C898FB213F, 0xBF597FC7BEEF0EE4,
+	0xC6E00BF33DA88FC2, 0xD5A79147930AA725, 0x06CA6351E003826F, 0x142929670A0E6E70, 0x27B70A8546D22FFC, 0x2E1B21385C26C926, 0x4D2C6DFC5AC42AED,
+	0x53380D139D95B3DF, 0x650A73548BAF63DE, 0x766A0ABB3C77B2A8, 0x81C2C92E47EDAEE6, 0x92722C851482353B, 0xA2BFE8A14CF10364, 0xA81A664BBC423001,
+	0xC24B8B70D0F89791, 0xC76C51A30654BE30, 0xD192E819D6EF5218, 0xD69906245565A910, 0xF40E35855771202A, 0x106AA07032BBD1B8, 0x19A4C116B8D2D0C8,
+	0x1E376C085141AB53, 0x2748774CDF8EEB99, 0x34B0BCB5E19B48A8, 0x391C0CB3C5C95A63, 0x4ED8AA4AE3418ACB, 0x5B9CCA4F7763E373, 0x682E6FF3D6B2B8A3,
+	0x748F82EE5DEFB2FC, 0x78A5636F43172F60, 0x84C87814A1F0AB72, 0x8CC702081A6439EC, 0x90BEFFFA23631E28, 0xA4506CEBDE82BDE9, 0xBEF9A3F7B2C67915,
+	0xC67178F2E372532B, 0xCA273ECEEA26619C, 0xD186B8C721C0C207, 0xEADA7DD6CDE0EB1E, 0xF57D4F7FEE6ED178, 0x06F067AA72176FBA, 0x0A637DC5A2C898A6,
+	0x113F9804BEF90DAE, 0x1B710B35131C471B, 0x28DB77F523047D84, 0x32CAAB7B40C72493, 0x3C9EBE0A15C9BEBC, 0x431D67C49C100D4C, 0x4CC5D4BECB3E42B6,
+	0x597F299CFC657E2A, 0x5FCB6FAB3AD6FAEC, 0x6C44198C4A475817};
+
+enum class ShaImplementation : uint8_t
+{
+	PORTABLE,
+	SHA_NI
+};
+
+// Compression backend used by Sha1 and Sha256, picked on first use. SHA-NI is only selected when the
+// CPU supports it and it reproduces the portable output; SHA-512 always uses the portable code.
+ShaImplementation sha_implementation();
+std::string_view  sha_implementation_to_string(ShaImplementation implementation);
+
+// Each hash exposes its block geometry, initial chaining state and a single-block compression
+// function. Padding is left to the callers: HMAC over a TOTP counter always fits in fixed blocks.
+// compress() runs the portable code during constant evaluation and the runtime-selected
+// implementation otherwise, so the whole HMAC/TOTP stack can be evaluated at compile time.
+struct Sha1
+{
+	using word_type	 = uint32_t;
+	using state_type = std::array<uint32_t, 5>;
+
+	static constexpr size_t block_size	= 64;
+	static constexpr size_t digest_size = 20;
+	static constexpr size_t length_size = 8;
+
+	static constexpr state_type initial_state = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+	static constexpr void compress(state_type& state, const uint8_t* block);
+	static constexpr void compress_portable(state_type& state, const uint8_t* block);
+	static void			  compress_runtime(state_type& state, const uint8_t* block);
+};
+
+struct Sha256
+{
+	using word_type	 = uint32_t;
+	using state_type = std::array<uint32_t, 8>;
+
+	static constexpr size_t block_size	= 64;
+	static constexpr size_t digest_size = 32;
+	static constexpr size_t length_size = 8;
+
+	static constexpr state_type initial_state = {0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19};
+
+	static constexpr void compress(state_type& state, const uint8_t* block);
+	static constexpr void compress_portable(state_type& state, const uint8_t* block);
+	static void			  compress_runtime(state_type& state, const uint8_t* block);
+};
+
+struct Sha512
+{
+	using word_type	 = uint64_t;
+	using state_type = std::array<uint64_t, 8>;
+
+	static constexpr size_t block_size	= 128;
+	static constexpr size_t digest_size = 64;
+	static constexpr size_t length_size = 16;
+
+	static constexpr state_type initial_state = {0x6A09E667F3BCC908,
+												 0xBB67AE8584CAA73B,
+												 0x3C6EF372FE94F82B,
+												 0xA54FF53A5F1D36F1,
+												 0x510E527FADE682D1,
+												 0x9B05688C2B3E6C1F,
+												 0x1F83D9ABFB41BD6B,
+												 0x5BE0CD19137E2179};
+
+	static constexpr void compress(state_type& state, const uint8_t* block);
+	static constexpr void compress_portable(state_type& state, const uint8_t* block);
+};
+
+constexpr void Sha1::compress(state_type& state, const uint8_t* block)
+{
+	if consteval
+	{
+		compress_portable(state, block);
+	}
+	else
+	{
+		compress_runtime(state, block);
+	}
+}
+
+constexpr void Sha256::compress(state_type& state, const uint8_t* block)
+{
+	if consteval
+	{
+		compress_portable(state, block);
+	}
+	else
+	{
+		compress_runtime(state, block);
+	}
+}
+
+constexpr void Sha512::compress(state_type& state, const uint8_t* block)
+{
+	compress_portable(state, block);
+}
+
+constexpr void Sha1::compress_portable(state_type& state, const uint8_t* block)
+{
+	uint32_t w[80];
+
+	for (size_t i = 0; i < 16; ++i)
+	{
+		w[i] = load_be32(block + i * 4);
+	}
+
+	for (size_t i = 16; i < 80; ++i)
+	{
+		w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+
+	for (size_t i = 0; i < 80; ++i)
+	{
+		uint32_t f;
+		uint32_t k;
+
+		if (i < 20)
+		{
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		}
+		else if (i < 40)
+		{
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		}
+		else if (i < 60)
+		{
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		}
+		else
+		{
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+
+		uint32_t temp = std::rotl(a, 5) + f + e + k + w[i];
+		e			  = d;
+		d			  = c;
+		c			  = std::rotl(b, 30);
+		b			  = a;
+		a			  = temp;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+constexpr void Sha256::compress_portable(state_type& state, const uint8_t* block)
+{
+	uint32_t w[64];
+
+	for (size_t i = 0; i < 16; ++i)
+	{
+		w[i] = load_be32(block + i * 4);
+	}
+
+	for (size_t i = 16; i < 64; ++i)
+	{
+		uint32_t s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i]		= w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = state[0];
+	uint32_t b = state[1];
+	uint32_t c = state[2];
+	uint32_t d = state[3];
+	uint32_t e = state[4];
+	uint32_t f = state[5];
+	uint32_t g = state[6];
+	uint32_t h = state[7];
+
+	for (size_t i = 0; i < 64; ++i)
+	{
+		uint32_t s1	   = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+		uint32_t ch	   = (e & f) ^ (~e & g);
+		uint32_t temp1 = h + s1 + ch + d_sha256_round_constants[i] + w[i];
+		uint32_t s0	   = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+		uint32_t maj   = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t temp2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+constexpr void Sha512::compress_portable(state_type& state, const uint8_t* block)
+{
+	uint64_t w[80];
+
+	for (size_t i = 0; i < 16; ++i)
+	{
+		w[i] = load_be64(block + i * 8);
+	}
+
+	for (size_t i = 16; i < 80; ++i)
+	{
+		uint64_t s0 = std::rotr(w[i - 15], 1) ^ std::rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
+		uint64_t s1 = std::rotr(w[i - 2], 19) ^ std::rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
+		w[i]		= w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint64_t a = state[0];
+	uint64_t b = state[1];
+	uint64_t c = state[2];
+	uint64_t d = state[3];
+	uint64_t e = state[4];
+	uint64_t f = state[5];
+	uint64_t g = state[6];
+	uint64_t h = state[7];
+
+	for (size_t i = 0; i < 80; ++i)
+	{
+		uint64_t s1	   = std::rotr(e, 14) ^ std::rotr(e, 18) ^ std::rotr(e, 41);
+		uint64_t ch	   = (e & f) ^ (~e & g);
+		uint64_t temp1 = h + s1 + ch + d_sha512_round_constants[i] + w[i];
+		uint64_t s0	   = std::rotr(a, 28) ^ std::rotr(a, 34) ^ std::rotr(a, 39);
+		uint64_t maj   = (a & b) ^ (a & c) ^ (b & c);
+		uint64_t temp2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+template<typename Hash>
+constexpr void sha_store_digest(const typename Hash::state_type& state, uint8_t* digest)
+{
+	for (size_t i = 0; i < state.size(); ++i)
+	{
+		if constexpr (sizeof(typename Hash::word_type) == 8)
+		{
+			store_be64(digest + i * 8, state[i]);
+		}
+		else
+		{
+			store_be32(digest + i * 4, state[i]);
+		}
+	}
+}
+
+// Writes the Merkle-Damgard length field into the last length_size bytes of a block.
+template<typename Hash>
+constexpr void sha_store_length(uint8_t* block, uint64_t message_size)
+{
+	std::fill_n(block + Hash::block_size - Hash::length_size, Hash::length_size, 0);
+	store_be64(block + Hash::block_size - 8, message_size * 8);
+}
+
+// One-shot hash of an arbitrary message on stack buffers.
+template<typename Hash>
+constexpr void sha_digest(std::span<const uint8_t> message, uint8_t* digest)
+{
+	typename Hash::state_type state = Hash::initial_state;
+
+	size_t offset = 0;
+	for (; offset + Hash::block_size <= message.size(); offset += Hash::block_size)
+	{
+		Hash::compress(state, message.data() + offset);
+	}
+
+	uint8_t block[Hash::block_size * 2] = {};
+	size_t	remaining					 = message.size() - offset;
+	std::copy_n(message.data() + offset, remaining, block);
+	block[remaining] = 0x80;
+
+	size_t total = (remaining + 1 + Hash::length_size <= Hash::block_size) ? Hash::block_size : Hash::block_size * 2;
+	sha_store_length<Hash>(block + total - Hash::block_size, message.size());
+
+	for (size_t i = 0; i < total; i += Hash::block_size)
+	{
+		Hash::compress(state, block + i);
+	}
+
+	sha_store_digest<Hash>(state, digest);
+}
+
+} // namespace UTILS
+
+#endif // SHA_HPP
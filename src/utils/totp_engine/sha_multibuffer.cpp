@@ -0,0 +1,462 @@
+#include "sha_multibuffer.hpp"
+
+#include "totp_engine.hpp"
+
+#include <tuple>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOTP_ENGINE_X86_SIMD 1
+#endif
+
+namespace
+{
+using UTILS::HmacKey;
+using UTILS::Sha1;
+using UTILS::Sha256;
+using UTILS::SimdLevel;
+
+template<typename Hash>
+void hotp_scalar(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		codes[i] = UTILS::hotp(keys[i], counters[i], digits[i]);
+	}
+}
+
+#ifdef TOTP_ENGINE_X86_SIMD
+// Vector helpers are always inlined into target-specific callers, so the ABI warnings about returning
+// wide vectors never apply. Instantiation happens at the end of the translation unit, hence no
+// push/pop.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+// The kernels below are written once against GCC vector extensions and instantiated for 4, 8 and
+// 16 lanes. They are always inlined into the target-specific entry points, which is where the
+// actual SSE2/AVX2/AVX-512 code generation happens.
+template<size_t Lanes>
+struct LaneVector;
+
+template<>
+struct LaneVector<4>
+{
+	typedef uint32_t type __attribute__((vector_size(16)));
+};
+
+template<>
+struct LaneVector<8>
+{
+	typedef uint32_t type __attribute__((vector_size(32)));
+};
+
+template<>
+struct LaneVector<16>
+{
+	typedef uint32_t type __attribute__((vector_size(64)));
+};
+
+// Taken by reference: passing a 64-byte vector by value draws a note about a GCC 4.6 ABI change that
+// the pragma above does not silence.
+template<typename V>
+[[gnu::always_inline]] inline V rotl(const V& value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+template<typename V>
+[[gnu::always_inline]] inline V rotr(const V& value, int bits)
+{
+	return (value >> bits) | (value << (32 - bits));
+}
+
+// w holds the 16-word message schedule window and is consumed in place.
+template<typename V>
+[[gnu::always_inline]] inline void sha1_compress_lanes(V (&state)[5], V (&w)[16])
+{
+	V a = state[0];
+	V b = state[1];
+	V c = state[2];
+	V d = state[3];
+	V e = state[4];
+
+	for (size_t i = 0; i < 80; ++i)
+	{
+		if (i >= 16)
+		{
+			w[i & 15] = rotl(w[(i - 3) & 15] ^ w[(i - 8) & 15] ^ w[(i - 14) & 15] ^ w[i & 15], 1);
+		}
+
+		V		 f;
+		uint32_t k;
+
+		if (i < 20)
+		{
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		}
+		else if (i < 40)
+		{
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		}
+		else if (i < 60)
+		{
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		}
+		else
+		{
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+
+		V temp = rotl(a, 5) + f + e + k + w[i & 15];
+		e	   = d;
+		d	   = c;
+		c	   = rotl(b, 30);
+		b	   = a;
+		a	   = temp;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+template<typename V>
+[[gnu::always_inline]] inline void sha256_compress_lanes(V (&state)[8], V (&w)[16])
+{
+	V a = state[0];
+	V b = state[1];
+	V c = state[2];
+	V d = state[3];
+	V e = state[4];
+	V f = state[5];
+	V g = state[6];
+	V h = state[7];
+
+	for (size_t i = 0; i < 64; ++i)
+	{
+		if (i >= 16)
+		{
+			V w15	  = w[(i - 15) & 15];
+			V w2	  = w[(i - 2) & 15];
+			V s0	  = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+			V s1	  = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+			w[i & 15] = w[i & 15] + s0 + w[(i - 7) & 15] + s1;
+		}
+
+		V s1	= rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+		V ch	= (e & f) ^ (~e & g);
+		V temp1 = h + s1 + ch + UTILS::d_sha256_round_constants[i] + w[i & 15];
+		V s0	= rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+		V maj	= (a & b) ^ (a & c) ^ (b & c);
+		V temp2 = s0 + maj;
+
+		h = g;
+		g = f;
+		f = e;
+		e = d + temp1;
+		d = c;
+		c = b;
+		b = a;
+		a = temp1 + temp2;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+// One HMAC per lane. The inner and outer messages have a fixed shape (8-byte counter, then the
+// inner digest), so the padded blocks are built directly in transposed form without byte shuffles.
+template<typename Hash, size_t Lanes>
+[[gnu::always_inline]] inline void hotp_lanes(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes)
+{
+	using V = typename LaneVector<Lanes>::type;
+
+	constexpr size_t words = std::tuple_size_v<typename Hash::state_type>;
+
+	V inner[words];
+	V outer[words];
+	V w[16];
+
+	for (size_t j = 0; j < words; ++j)
+	{
+		for (size_t lane = 0; lane < Lanes; ++lane)
+		{
+			inner[j][lane] = keys[lane].inner[j];
+			outer[j][lane] = keys[lane].outer[j];
+		}
+	}
+
+	for (size_t lane = 0; lane < Lanes; ++lane)
+	{
+		w[0][lane] = static_cast<uint32_t>(counters[lane] >> 32);
+		w[1][lane] = static_cast<uint32_t>(counters[lane]);
+	}
+	w[2] = V {} + 0x80000000u;
+	for (size_t j = 3; j < 15; ++j)
+	{
+		w[j] = V {};
+	}
+	w[15] = V {} + static_cast<uint32_t>((Hash::block_size + 8) * 8);
+
+	if constexpr (std::is_same_v<Hash, Sha1>)
+	{
+		sha1_compress_lanes(inner, w);
+	}
+	else
+	{
+		sha256_compress_lanes(inner, w);
+	}
+
+	for (size_t j = 0; j < words; ++j)
+	{
+		w[j] = inner[j];
+	}
+	w[words] = V {} + 0x80000000u;
+	for (size_t j = words + 1; j < 15; ++j)
+	{
+		w[j] = V {};
+	}
+	w[15] = V {} + static_cast<uint32_t>((Hash::block_size + Hash::digest_size) * 8);
+
+	if constexpr (std::is_same_v<Hash, Sha1>)
+	{
+		sha1_compress_lanes(outer, w);
+	}
+	else
+	{
+		sha256_compress_lanes(outer, w);
+	}
+
+	for (size_t lane = 0; lane < Lanes; ++lane)
+	{
+		uint8_t digest[Hash::digest_size];
+		for (size_t j = 0; j < words; ++j)
+		{
+			UTILS::store_be32(digest + j * 4, outer[j][lane]);
+		}
+		codes[lane] = UTILS::truncate_digest(digest, digits[lane]);
+	}
+}
+
+template<typename Hash, size_t Lanes>
+[[gnu::always_inline]] inline void hotp_chunks(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	size_t i = 0;
+	for (; i + Lanes <= count; i += Lanes)
+	{
+		hotp_lanes<Hash, Lanes>(keys + i, counters + i, digits + i, codes + i);
+	}
+
+	hotp_scalar(keys + i, counters + i, digits + i, codes + i, count - i);
+}
+
+template<typename Hash>
+[[gnu::target("sse2")]] void hotp_sse2(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	hotp_chunks<Hash, 4>(keys, counters, digits, codes, count);
+}
+
+template<typename Hash>
+[[gnu::target("avx2")]] void hotp_avx2(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	hotp_chunks<Hash, 8>(keys, counters, digits, codes, count);
+}
+
+template<typename Hash>
+[[gnu::target("avx512f")]] void hotp_avx512(const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	hotp_chunks<Hash, 16>(keys, counters, digits, codes, count);
+}
+#endif
+
+template<typename Hash>
+void hotp_dispatch(SimdLevel level, const HmacKey<Hash> *keys, const uint64_t *counters, const uint32_t *digits, uint32_t *codes, size_t count)
+{
+	switch (level)
+	{
+#ifdef TOTP_ENGINE_X86_SIMD
+		case SimdLevel::AVX512:
+			hotp_avx512(keys, counters, digits, codes, count);
+			return;
+		case SimdLevel::AVX2:
+			hotp_avx2(keys, counters, digits, codes, count);
+			return;
+		case SimdLevel::SSE2:
+			hotp_sse2(keys, counters, digits, codes, count);
+			return;
+#endif
+		default:
+			hotp_scalar(keys, counters, digits, codes, count);
+			return;
+	}
+}
+
+// Runs a batch that spans full vectors plus a scalar tail and compares it with the scalar path.
+template<typename Hash>
+bool matches_scalar(SimdLevel level)
+{
+	constexpr size_t count = UTILS::d_max_simd_lanes * 2 + 3;
+
+	HmacKey<Hash> keys[count];
+	uint64_t	  counters[count];
+	uint32_t	  digits[count];
+	uint32_t	  expected[count];
+	uint32_t	  actual[count];
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint8_t secret[20];
+		for (size_t j = 0; j < sizeof(secret); ++j)
+		{
+			secret[j] = static_cast<uint8_t>(i * 31 + j * 7 + 1);
+		}
+
+		keys[i]		= UTILS::make_hmac_key<Hash>(secret);
+		counters[i] = (static_cast<uint64_t>(i) << 33) + 56666666 + i;
+		digits[i]	= 6 + static_cast<uint32_t>(i % 4);
+	}
+
+	hotp_scalar(keys, counters, digits, expected, count);
+	hotp_dispatch(level, keys, counters, digits, actual, count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (expected[i] != actual[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool cpu_supports(SimdLevel level)
+{
+#ifdef TOTP_ENGINE_X86_SIMD
+	__builtin_cpu_init();
+
+	switch (level)
+	{
+		case SimdLevel::AVX512:
+			return __builtin_cpu_supports("avx512f");
+		case SimdLevel::AVX2:
+			return __builtin_cpu_supports("avx2");
+		case SimdLevel::SSE2:
+			return __builtin_cpu_supports("sse2");
+		case SimdLevel::SCALAR:
+			return true;
+	}
+#endif
+
+	return level == SimdLevel::SCALAR;
+}
+
+SimdLevel detect_simd_level()
+{
+	for (SimdLevel level : {SimdLevel::AVX512, SimdLevel::AVX2, SimdLevel::SSE2})
+	{
+		// Four software lanes do not beat one SHA-NI hash per code.
+		if (level == SimdLevel::SSE2 && UTILS::sha_implementation() == UTILS::ShaImplementation::SHA_NI)
+		{
+			break;
+		}
+
+		if (cpu_supports(level) && matches_scalar<Sha1>(level) && matches_scalar<Sha256>(level))
+		{
+			return level;
+		}
+	}
+
+	return SimdLevel::SCALAR;
+}
+} // namespace
+
+namespace UTILS
+{
+
+SimdLevel simd_level()
+{
+	static const SimdLevel level = detect_simd_level();
+	return level;
+}
+
+size_t simd_lane_count(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX512:
+			return 16;
+		case SimdLevel::AVX2:
+			return 8;
+		case SimdLevel::SSE2:
+			return 4;
+		case SimdLevel::SCALAR:
+			return 1;
+	}
+
+	return 1;
+}
+
+std::string_view simd_level_to_string(SimdLevel level)
+{
+	switch (level)
+	{
+		case SimdLevel::AVX512:
+			return "AVX-512 (16 lanes)";
+		case SimdLevel::AVX2:
+			return "AVX2 (8 lanes)";
+		case SimdLevel::SSE2:
+			return "SSE2 (4 lanes)";
+		case SimdLevel::SCALAR:
+			return "scalar";
+	}
+
+	return "";
+}
+
+void hotp_batch(std::span<const HmacKey<Sha1>> keys,
+				std::span<const uint64_t>	   counters,
+				std::span<const uint32_t>	   digits,
+				std::span<uint32_t>			   codes)
+{
+	hotp_batch(simd_level(), keys, counters, digits, codes);
+}
+
+void hotp_batch(std::span<const HmacKey<Sha256>> keys,
+				std::span<const uint64_t>		 counters,
+				std::span<const uint32_t>		 digits,
+				std::span<uint32_t>				 codes)
+{
+	hotp_batch(simd_level(), keys, counters, digits, codes);
+}
+
+void hotp_batch(SimdLevel						level,
+				std::span<const HmacKey<Sha1>> keys,
+				std::span<const uint64_t>	   counters,
+				std::span<const uint32_t>	   digits,
+				std::span<uint32_t>			   codes)
+{
+	hotp_dispatch(level, keys.data(), counters.data(), digits.data(), codes.data(), keys.size());
+}
+
+void hotp_batch(SimdLevel						  level,
+				std::span<const HmacKey<Sha256>> keys,
+				std::span<const uint64_t>		 counters,
+				std::span<const uint32_t>		 digits,
+				std::span<uint32_t>				 codes)
+{
+	hotp_dispatch(level, keys.data(), counters.data(), digits.data(), codes.data(), keys.size());
+}
+
+} // namespace UTILS
@@ -0,0 +1,54 @@
+#ifndef SHA_MULTIBUFFER_HPP
+#define SHA_MULTIBUFFER_HPP
+
+#include "hmac.hpp"
+#include "sha.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace UTILS
+{
+enum class SimdLevel : uint8_t
+{
+	SCALAR,
+	SSE2,
+	AVX2,
+	AVX512
+};
+
+constexpr size_t d_max_simd_lanes = 16;
+
+// Widest lane width supported by the CPU whose output matched the scalar path bit for bit.
+// Detected once on first use.
+SimdLevel		 simd_level();
+size_t			 simd_lane_count(SimdLevel level);
+std::string_view simd_level_to_string(SimdLevel level);
+
+// Multi-buffer HOTP: every key/counter pair is an independent HMAC, so up to simd_lane_count()
+// of them are hashed side by side, one per SIMD lane. All spans must have the same length.
+void hotp_batch(std::span<const HmacKey<Sha1>> keys,
+				std::span<const uint64_t>	   counters,
+				std::span<const uint32_t>	   digits,
+				std::span<uint32_t>			   codes);
+void hotp_batch(std::span<const HmacKey<Sha256>> keys,
+				std::span<const uint64_t>		 counters,
+				std::span<const uint32_t>		 digits,
+				std::span<uint32_t>				 codes);
+
+// Same as above with an explicit lane width, used to cross-check implementations.
+void hotp_batch(SimdLevel						level,
+				std::span<const HmacKey<Sha1>> keys,
+				std::span<const uint64_t>	   counters,
+				std::span<const uint32_t>	   digits,
+				std::span<uint32_t>			   codes);
+void hotp_batch(SimdLevel						  level,
+				std::span<const HmacKey<Sha256>> keys,
+				std::span<const uint64_t>		 counters,
+				std::span<const uint32_t>		 digits,
+				std::span<uint32_t>				 codes);
+
+} // namespace UTILS
+
+#endif // SHA_MULTIBUFFER_HPP
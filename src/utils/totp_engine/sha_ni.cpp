@@ -0,0 +1,152 @@
+#include "sha_ni.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOTP_ENGINE_SHA_NI 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+#ifdef TOTP_ENGINE_SHA_NI
+// sha1rnds4 takes the round function as an immediate; the switch folds away once the caller's loop is unrolled.
+[[gnu::target("sha,sse4.1"), gnu::always_inline]] inline __m128i sha1_rounds4(__m128i abcd, __m128i e, size_t group)
+{
+	switch (group / 5)
+	{
+		case 0:
+			return _mm_sha1rnds4_epu32(abcd, e, 0);
+		case 1:
+			return _mm_sha1rnds4_epu32(abcd, e, 1);
+		case 2:
+			return _mm_sha1rnds4_epu32(abcd, e, 2);
+		default:
+			return _mm_sha1rnds4_epu32(abcd, e, 3);
+	}
+}
+#endif
+} // namespace
+
+namespace UTILS
+{
+
+bool sha_ni_supported()
+{
+#ifdef TOTP_ENGINE_SHA_NI
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#else
+	return false;
+#endif
+}
+
+#ifdef TOTP_ENGINE_SHA_NI
+
+// Each iteration covers four rounds. The message words for group g live in msg[g % 4]; while that
+// group is being hashed the schedule for groups g + 1 .. g + 3 is advanced in the other registers.
+[[gnu::target("sha,sse4.1")]] void sha1_compress_sha_ni(Sha1::state_type& state, const uint8_t* block)
+{
+	const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607, 0x08090A0B0C0D0E0F);
+
+	__m128i abcd	  = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state.data())), 0x1B);
+	__m128i e		  = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+	__m128i abcd_save = abcd;
+	__m128i e_save	  = e;
+
+	__m128i msg[4];
+	for (size_t i = 0; i < 4; ++i)
+	{
+		msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16)), byte_swap);
+	}
+
+#pragma GCC unroll 20
+	for (size_t group = 0; group < 20; ++group)
+	{
+		__m128i e_next = group == 0 ? _mm_add_epi32(e, msg[0]) : _mm_sha1nexte_epu32(e, msg[group % 4]);
+		e			   = abcd;
+
+		if (group >= 3 && group <= 18)
+		{
+			msg[(group - 3) % 4] = _mm_sha1msg2_epu32(msg[(group - 3) % 4], msg[group % 4]);
+		}
+
+		abcd = sha1_rounds4(abcd, e_next, group);
+
+		if (group >= 1 && group <= 16)
+		{
+			msg[(group - 1) % 4] = _mm_sha1msg1_epu32(msg[(group - 1) % 4], msg[group % 4]);
+		}
+
+		if (group >= 2 && group <= 17)
+		{
+			msg[(group - 2) % 4] = _mm_xor_si128(msg[(group - 2) % 4], msg[group % 4]);
+		}
+	}
+
+	e	 = _mm_sha1nexte_epu32(e, e_save);
+	abcd = _mm_shuffle_epi32(_mm_add_epi32(abcd, abcd_save), 0x1B);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state.data()), abcd);
+	state[4] = static_cast<uint32_t>(_mm_extract_epi32(e, 3));
+}
+
+// The SHA-256 instructions work on the state split as ABEF/CDGH, so it is reshuffled on the way in
+// and out. Message words for group g live in msg[g % 4] as in the SHA-1 kernel.
+[[gnu::target("sha,sse4.1")]] void sha256_compress_sha_ni(Sha256::state_type& state, const uint8_t* block)
+{
+	const __m128i byte_swap = _mm_set_epi64x(0x0C0D0E0F08090A0B, 0x0405060700010203);
+
+	__m128i cdab   = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state.data())), 0xB1);
+	__m128i hgfe   = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state.data() + 4)), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(cdab, hgfe, 8);
+	__m128i state1 = _mm_blend_epi16(hgfe, cdab, 0xF0);
+
+	__m128i abef_save = state0;
+	__m128i cdgh_save = state1;
+
+	__m128i msg[4];
+	for (size_t i = 0; i < 4; ++i)
+	{
+		msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16)), byte_swap);
+	}
+
+#pragma GCC unroll 16
+	for (size_t group = 0; group < 16; ++group)
+	{
+		__m128i words = _mm_add_epi32(msg[group % 4], _mm_loadu_si128(reinterpret_cast<const __m128i*>(d_sha256_round_constants + group * 4)));
+		state1		  = _mm_sha256rnds2_epu32(state1, state0, words);
+		state0		  = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0E));
+
+		if (group < 12)
+		{
+			__m128i& next  = msg[group % 4];
+			__m128i	 tail  = msg[(group + 3) % 4];
+			__m128i	 inner = _mm_add_epi32(_mm_sha256msg1_epu32(next, msg[(group + 1) % 4]), _mm_alignr_epi8(tail, msg[(group + 2) % 4], 4));
+			next		   = _mm_sha256msg2_epu32(inner, tail);
+		}
+	}
+
+	state0 = _mm_add_epi32(state0, abef_save);
+	state1 = _mm_add_epi32(state1, cdgh_save);
+
+	__m128i feba = _mm_shuffle_epi32(state0, 0x1B);
+	__m128i dchg = _mm_shuffle_epi32(state1, 0xB1);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state.data()), _mm_blend_epi16(feba, dchg, 0xF0));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state.data() + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#else
+
+void sha1_compress_sha_ni(Sha1::state_type& state, const uint8_t* block)
+{
+	Sha1::compress_portable(state, block);
+}
+
+void sha256_compress_sha_ni(Sha256::state_type& state, const uint8_t* block)
+{
+	Sha256::compress_portable(state, block);
+}
+
+#endif
+
+} // namespace UTILS
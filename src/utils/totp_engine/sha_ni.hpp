@@ -0,0 +1,17 @@
+#ifndef SHA_NI_HPP
+#define SHA_NI_HPP
+
+#include "sha.hpp"
+
+namespace UTILS
+{
+// True when the CPU exposes the SHA extensions together with the SSE4.1 shuffles the kernels need.
+bool sha_ni_supported();
+
+// Hardware compression functions; only call after sha_ni_supported() returned true.
+void sha1_compress_sha_ni(Sha1::state_type& state, const uint8_t* block);
+void sha256_compress_sha_ni(Sha256::state_type& state, const uint8_t* block);
+
+} // namespace UTILS
+
+#endif // SHA_NI_HPP
@@ -0,0 +1,102 @@
+#include "totp_engine.hpp"
+
+namespace
+{
+struct RfcVector
+{
+	uint64_t time;
+	uint32_t sha1;
+	uint32_t sha256;
+	uint32_t sha512;
+};
+
+// RFC 6238 appendix B, 8 digits, 30 second period.
+constexpr RfcVector d_rfc6238_vectors[] = {
+	{59, 94287082, 46119246, 90693936},
+	{1111111109, 7081804, 68084774, 25091201},
+	{1111111111, 14050471, 67062674, 99943326},
+	{1234567890, 89005924, 91819424, 93441116},
+	{2000000000, 69279037, 90698825, 38618901},
+	{20000000000, 65353130, 77737706, 47863826},
+};
+
+// The ASCII seed "1234567890..." truncated to 20, 32 and 64 bytes, in Base32 so the decoder is covered too.
+constexpr std::string_view d_rfc6238_seed_sha1	 = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ";
+constexpr std::string_view d_rfc6238_seed_sha256 = "GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZA";
+constexpr std::string_view d_rfc6238_seed_sha512 =
+	"GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQGEZDGNA";
+
+template<typename Hash>
+constexpr bool rfc6238_matches(std::string_view seed, uint32_t RfcVector::*expected)
+{
+	uint8_t				  secret[UTILS::d_max_secret_size] = {};
+	std::optional<size_t> size							   = UTILS::decode_base32(seed, secret);
+
+	if (!size)
+	{
+		return false;
+	}
+
+	const UTILS::HmacKey<Hash> key = UTILS::make_hmac_key<Hash>({secret, *size});
+
+	for (const auto &vector : d_rfc6238_vectors)
+	{
+		if (UTILS::Totp<Hash, 8, 30>::generate(key, vector.time) != vector.*expected)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// The same vectors are checked by the compiler through the portable compression functions and
+// again at runtime by totp_self_test() through whichever implementation was selected.
+static_assert(rfc6238_matches<UTILS::Sha1>(d_rfc6238_seed_sha1, &RfcVector::sha1), "RFC 6238 SHA-1 vectors failed");
+static_assert(rfc6238_matches<UTILS::Sha256>(d_rfc6238_seed_sha256, &RfcVector::sha256), "RFC 6238 SHA-256 vectors failed");
+static_assert(rfc6238_matches<UTILS::Sha512>(d_rfc6238_seed_sha512, &RfcVector::sha512), "RFC 6238 SHA-512 vectors failed");
+} // namespace
+
+namespace UTILS
+{
+
+std::string_view algorithm_to_string(TOTPAlgorithm algorithm)
+{
+	switch (algorithm)
+	{
+		case TOTPAlgorithm::SHA1:
+			return "SHA1";
+		case TOTPAlgorithm::SHA256:
+			return "SHA256";
+		case TOTPAlgorithm::SHA512:
+			return "SHA512";
+	}
+
+	return "";
+}
+
+std::optional<TOTPAlgorithm> algorithm_from_string(std::string_view name)
+{
+	if (name == "SHA1" || name == "sha1")
+	{
+		return TOTPAlgorithm::SHA1;
+	}
+	if (name == "SHA256" || name == "sha256")
+	{
+		return TOTPAlgorithm::SHA256;
+	}
+	if (name == "SHA512" || name == "sha512")
+	{
+		return TOTPAlgorithm::SHA512;
+	}
+
+	return std::nullopt;
+}
+
+bool totp_self_test()
+{
+	return rfc6238_matches<Sha1>(d_rfc6238_seed_sha1, &RfcVector::sha1) && rfc6238_matches<Sha256>(d_rfc6238_seed_sha256, &RfcVector::sha256) &&
+		   rfc6238_matches<Sha512>(d_rfc6238_seed_sha512, &RfcVector::sha512);
+}
+
+} // namespace UTILS
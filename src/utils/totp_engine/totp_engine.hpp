@@ -0,0 +1,262 @@
+#ifndef TOTP_ENGINE_HPP
+#define TOTP_ENGINE_HPP
+
+#include "hmac.hpp"
+#include "sha.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace UTILS
+{
+enum class TOTPAlgorithm : uint8_t
+{
+	SHA1,
+	SHA256,
+	SHA512
+};
+
+// Largest decoded secret accepted; RFC 6238 seeds top out at 64 bytes for SHA-512.
+constexpr size_t d_max_secret_size = 128;
+
+// 31-bit truncated values never exceed ten decimal digits.
+constexpr size_t		   d_max_code_digits = 10;
+inline constexpr uint32_t d_powers_of_ten[d_max_code_digits] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+std::string_view			 algorithm_to_string(TOTPAlgorithm algorithm);
+std::optional<TOTPAlgorithm> algorithm_from_string(std::string_view name);
+
+constexpr int base32_value(char c)
+{
+	if (c >= 'A' && c <= 'Z')
+	{
+		return c - 'A';
+	}
+	if (c >= 'a' && c <= 'z')
+	{
+		return c - 'a';
+	}
+	if (c >= '2' && c <= '7')
+	{
+		return c - '2' + 26;
+	}
+	return -1;
+}
+
+// Decodes a case-insensitive, unpadded Base32 secret into a caller-provided buffer.
+// Characters outside the alphabet are skipped; returns nullopt if the output does not fit.
+constexpr std::optional<size_t> decode_base32(std::string_view encoded, std::span<uint8_t> output)
+{
+	uint32_t buffer = 0;
+	int		 bits	= 0;
+	size_t	 size	= 0;
+
+	for (char c : encoded)
+	{
+		int value = base32_value(c);
+		if (value < 0)
+		{
+			continue;
+		}
+
+		buffer = (buffer << 5) | static_cast<uint32_t>(value);
+		bits += 5;
+
+		if (bits >= 8)
+		{
+			if (size == output.size())
+			{
+				return std::nullopt;
+			}
+
+			bits -= 8;
+			output[size++] = static_cast<uint8_t>(buffer >> bits);
+		}
+	}
+
+	return size;
+}
+
+// RFC 4226 dynamic truncation to a 31-bit value.
+constexpr uint32_t dynamic_truncate(std::span<const uint8_t> digest)
+{
+	size_t offset = digest.back() & 0x0F;
+	return load_be32(digest.data() + offset) & 0x7FFFFFFF;
+}
+
+// RFC 4226 dynamic truncation reduced to the requested number of digits.
+constexpr uint32_t truncate_digest(std::span<const uint8_t> digest, uint32_t digits)
+{
+	uint32_t binary = dynamic_truncate(digest);
+
+	if (digits < d_max_code_digits)
+	{
+		binary %= d_powers_of_ten[digits];
+	}
+
+	return binary;
+}
+
+// Writes the code zero-padded to exactly digits characters without touching the heap.
+// Returns the number of characters written, or 0 if digits is out of range or the buffer is too small.
+constexpr size_t format_code(uint32_t code, uint32_t digits, std::span<char> output)
+{
+	if (digits == 0 || digits > d_max_code_digits || output.size() < digits)
+	{
+		return 0;
+	}
+
+	if (digits < d_max_code_digits)
+	{
+		code %= d_powers_of_ten[digits];
+	}
+
+	for (size_t i = digits; i > 0; --i)
+	{
+		output[i - 1] = static_cast<char>('0' + code % 10);
+		code /= 10;
+	}
+
+	return digits;
+}
+
+// Parses a submitted code of exactly digits decimal characters. Every character is visited so the
+// time taken does not depend on where a malformed code goes wrong.
+constexpr std::optional<uint32_t> parse_code(std::string_view text, uint32_t digits)
+{
+	if (digits == 0 || digits > d_max_code_digits || text.size() != digits)
+	{
+		return std::nullopt;
+	}
+
+	uint64_t value	 = 0;
+	bool	 invalid = false;
+
+	for (char c : text)
+	{
+		invalid |= c < '0' || c > '9';
+		value = value * 10 + static_cast<uint8_t>(c - '0');
+	}
+
+	if (invalid || value > UINT32_MAX)
+	{
+		return std::nullopt;
+	}
+
+	return static_cast<uint32_t>(value);
+}
+
+// Branch-free equality so the comparison itself leaks nothing about how many bits matched.
+constexpr bool codes_equal(uint32_t lhs, uint32_t rhs)
+{
+	uint64_t difference = lhs ^ rhs;
+	return ((difference - 1) >> 63) != 0;
+}
+
+template<typename Hash>
+constexpr uint32_t hotp(const HmacKey<Hash>& key, uint64_t counter, uint32_t digits)
+{
+	uint8_t digest[Hash::digest_size] = {};
+	hmac_counter<Hash>(key, counter, digest);
+	return truncate_digest(digest, digits);
+}
+
+// HOTP for consecutive counters under one key, starting at first_counter; codes[i] receives the
+// code for first_counter + i. The padded message blocks are built once for the whole run.
+template<typename Hash>
+constexpr void hotp_range(const HmacKey<Hash>& key, uint64_t first_counter, uint32_t digits, std::span<uint32_t> codes)
+{
+	HmacCounterBlocks<Hash> blocks;
+	uint8_t					digest[Hash::digest_size] = {};
+
+	for (size_t i = 0; i < codes.size(); ++i)
+	{
+		blocks.digest(key, first_counter + i, digest);
+		codes[i] = truncate_digest(digest, digits);
+	}
+}
+
+// TOTP with the hash, digit count and period fixed at compile time, so the time-step division and
+// the modulus become constant folds instead of runtime divisions.
+template<typename Hash, uint32_t Digits, uint32_t Period>
+struct Totp
+{
+	static_assert(Digits >= 1 && Digits <= d_max_code_digits, "TOTP codes have 1 to 10 digits");
+	static_assert(Period > 0, "TOTP period must be positive");
+
+	using hash_type = Hash;
+
+	static constexpr uint32_t digits = Digits;
+	static constexpr uint32_t period = Period;
+
+	static constexpr uint32_t generate(const HmacKey<Hash>& key, uint64_t unix_time)
+	{
+		uint8_t digest[Hash::digest_size] = {};
+		hmac_counter<Hash>(key, unix_time / Period, digest);
+
+		uint32_t binary = dynamic_truncate(digest);
+		if constexpr (Digits < d_max_code_digits)
+		{
+			binary %= d_powers_of_ten[Digits];
+		}
+
+		return binary;
+	}
+};
+
+// Uniform signature for the runtime dispatch table. Specialised entries ignore the period and
+// digits arguments because theirs are baked in.
+template<typename Hash>
+using TotpFunction = uint32_t (*)(const HmacKey<Hash>& key, uint64_t unix_time, uint32_t period, uint32_t digits);
+
+template<typename Hash>
+uint32_t totp_generic(const HmacKey<Hash>& key, uint64_t unix_time, uint32_t period, uint32_t digits)
+{
+	return hotp(key, unix_time / period, digits);
+}
+
+template<typename Specialization>
+uint32_t totp_specialized(const HmacKey<typename Specialization::hash_type>& key, uint64_t unix_time, uint32_t, uint32_t)
+{
+	return Specialization::generate(key, unix_time);
+}
+
+// Picks a compile-time specialised generator for the common period/digit combinations and falls
+// back to the generic one for anything else loaded from config.
+template<typename Hash>
+TotpFunction<Hash> select_totp(uint32_t period, uint32_t digits)
+{
+	struct Entry
+	{
+		uint32_t		   period;
+		uint32_t		   digits;
+		TotpFunction<Hash> function;
+	};
+
+	static constexpr Entry table[] = {
+		{30, 6, totp_specialized<Totp<Hash, 6, 30>>},
+		{30, 7, totp_specialized<Totp<Hash, 7, 30>>},
+		{30, 8, totp_specialized<Totp<Hash, 8, 30>>},
+		{60, 6, totp_specialized<Totp<Hash, 6, 60>>},
+		{60, 8, totp_specialized<Totp<Hash, 8, 60>>},
+	};
+
+	for (const Entry& entry : table)
+	{
+		if (entry.period == period && entry.digits == digits)
+		{
+			return entry.function;
+		}
+	}
+
+	return totp_generic<Hash>;
+}
+
+// Runs the RFC 6238 appendix B vectors for all three algorithms.
+bool totp_self_test();
+
+} // namespace UTILS
+
+#endif // TOTP_ENGINE_HPP
@@ -0,0 +1,1034 @@
+#include "totp_http_server.hpp"
+
+#include "spdlog_wrapper.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <optional>
+#include <span>
+#include <thread>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr int	 d_max_epoll_events	  = 256;
+constexpr size_t d_max_json_body_size = 1024;
+
+static_assert(UTILS::d_http_max_account_size * 6 + 128 <= d_max_json_body_size, "an escaped account name must fit a reply body");
+static_assert(d_max_json_body_size + 256 <= UTILS::d_http_max_response_size, "a reply body and its head must fit one response");
+
+char ascii_lower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool iequals(std::string_view lhs, std::string_view rhs)
+{
+	return std::ranges::equal(lhs, rhs, [](char a, char b) { return ascii_lower(a) == ascii_lower(b); });
+}
+
+// Looks at every byte whatever the mismatch, so response times say nothing about how close a guess was.
+bool same_secret(std::string_view lhs, std::string_view rhs)
+{
+	unsigned difference = lhs.size() != rhs.size();
+	for (size_t i = 0; i < std::min(lhs.size(), rhs.size()); ++i)
+	{
+		difference |= static_cast<unsigned char>(lhs[i] ^ rhs[i]);
+	}
+	return difference == 0;
+}
+
+std::string_view trim(std::string_view text)
+{
+	while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+	{
+		text.remove_prefix(1);
+	}
+
+	while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+	{
+		text.remove_suffix(1);
+	}
+
+	return text;
+}
+
+int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+
+	c = ascii_lower(c);
+	return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Decodes %XX escapes, and '+' as a space in form fields. Returns nullopt if malformed or too long.
+std::optional<std::string_view> percent_decode(std::string_view text, std::span<char> output, bool form)
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		char c = text[i];
+		if (c == '%')
+		{
+			if (i + 2 >= text.size() || hex_value(text[i + 1]) < 0 || hex_value(text[i + 2]) < 0)
+			{
+				return std::nullopt;
+			}
+
+			c = static_cast<char>(hex_value(text[i + 1]) * 16 + hex_value(text[i + 2]));
+			i += 2;
+		}
+		else if (form && c == '+')
+		{
+			c = ' ';
+		}
+
+		if (size == output.size())
+		{
+			return std::nullopt;
+		}
+		output[size++] = c;
+	}
+
+	return std::string_view(output.data(), size);
+}
+
+// Returns the still-encoded value of a query string or form field.
+std::optional<std::string_view> find_field(std::string_view fields, std::string_view name)
+{
+	while (!fields.empty())
+	{
+		const size_t	 end	= fields.find('&');
+		std::string_view pair	= fields.substr(0, end);
+		const size_t	 equals = pair.find('=');
+
+		if (pair.substr(0, equals) == name)
+		{
+			return equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+		}
+
+		if (end == std::string_view::npos)
+		{
+			break;
+		}
+		fields.remove_prefix(end + 1);
+	}
+
+	return std::nullopt;
+}
+
+char* escape_json(char* output, std::string_view text)
+{
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			*output++ = '\\';
+			*output++ = c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			output = fmt::format_to(output, "\\u{:04x}", static_cast<unsigned>(c));
+		}
+		else
+		{
+			*output++ = c;
+		}
+	}
+
+	return output;
+}
+
+uint64_t monotonic_seconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::string_view reason_phrase(int status)
+{
+	switch (status)
+	{
+		case 200:
+			return "OK";
+		case 400:
+			return "Bad Request";
+		case 401:
+			return "Unauthorized";
+		case 403:
+			return "Forbidden";
+		case 404:
+			return "Not Found";
+		case 405:
+			return "Method Not Allowed";
+		case 413:
+			return "Content Too Large";
+		case 431:
+			return "Request Header Fields Too Large";
+		case 501:
+			return "Not Implemented";
+		default:
+			return "Internal Server Error";
+	}
+}
+} // namespace
+
+namespace UTILS
+{
+
+TOTPHttpServer::TOTPHttpServer(std::shared_ptr<TOTPManager> totp_manager, std::string token)
+	: m_totp_manager(std::move(totp_manager))
+	, m_token(std::move(token))
+{}
+
+uint16_t TOTPHttpServer::port() const
+{
+	return m_port;
+}
+
+void TOTPHttpServer::write_response(Connection& connection, int status, std::string_view body, bool keep_alive) const
+{
+	const size_t available = connection.output.size() - connection.output_size;
+	const auto	 result	   = fmt::format_to_n(connection.output.data() + connection.output_size,
+											  available,
+											  "HTTP/1.1 {} {}\r\n"
+											  "Content-Type: application/json\r\n"
+											  "Content-Length: {}\r\n"
+											  "Cache-Control: no-store\r\n"
+											  "{}{}\r\n"
+											  "{}",
+											  status,
+											  reason_phrase(status),
+											  body.size(),
+											  status == 401 ? "WWW-Authenticate: Bearer\r\n" : "",
+											  keep_alive ? "" : "Connection: close\r\n",
+											  body);
+
+	// Callers only get here with d_http_max_response_size free, which every reply fits.
+	connection.output_size += std::min(result.size, available);
+	connection.close_after_write |= !keep_alive;
+}
+
+void TOTPHttpServer::handle_request(Connection&		 connection,
+									std::string_view method,
+									std::string_view target,
+									std::string_view body,
+									bool			 keep_alive) const
+{
+	const size_t		   query_start = target.find('?');
+	const std::string_view path		   = target.substr(0, query_start);
+	const std::string_view query	   = query_start == std::string_view::npos ? std::string_view() : target.substr(query_start + 1);
+	const uint64_t		   unix_time   = static_cast<uint64_t>(time(NULL));
+
+	char reply[d_max_json_body_size];
+	char account_buffer[d_http_max_account_size];
+
+	if (path.starts_with("/totp/"))
+	{
+		if (method != "GET")
+		{
+			this->write_response(connection, 405, R"({"error":"method not allowed"})", keep_alive);
+			return;
+		}
+
+		std::optional<std::string_view>	 account	= percent_decode(path.substr(6), account_buffer, false);
+		std::optional<AccountParameters> parameters = account && !account->empty() ? m_totp_manager->get_account_parameters(*account) : std::nullopt;
+		std::optional<uint32_t>			 code		= parameters ? m_totp_manager->generate_code(*account, unix_time) : std::nullopt;
+		if (!code)
+		{
+			this->write_response(connection, 404, R"({"error":"unknown account"})", keep_alive);
+			return;
+		}
+
+		char		 digits[d_max_code_digits];
+		const size_t digit_count = format_code(*code, parameters->digits, digits);
+
+		char* end = fmt::format_to(reply, R"({{"account":")");
+		end		  = escape_json(end, *account);
+		end		  = fmt::format_to(end,
+								   R"(","code":"{}","digits":{},"valid_until":{}}})",
+								   std::string_view(digits, digit_count),
+								   parameters->digits,
+								   (unix_time / parameters->period + 1) * parameters->period);
+
+		this->write_response(connection, 200, std::string_view(reply, end), keep_alive);
+	}
+	else if (path == "/verify")
+	{
+		if (method != "GET" && method != "POST")
+		{
+			this->write_response(connection, 405, R"({"error":"method not allowed"})", keep_alive);
+			return;
+		}
+
+		const std::string_view			fields		 = method == "GET" ? query : body;
+		std::optional<std::string_view> account		 = find_field(fields, "account");
+		std::optional<std::string_view> code		 = find_field(fields, "code");
+		std::optional<std::string_view> window_field = find_field(fields, "window");
+
+		char code_buffer[d_max_code_digits];
+		char window_buffer[16];
+		account = account ? percent_decode(*account, account_buffer, true) : std::nullopt;
+		code	= code ? percent_decode(*code, code_buffer, true) : std::nullopt;
+		if (!account || account->empty() || !code)
+		{
+			this->write_response(connection, 400, R"({"error":"account and code are required"})", keep_alive);
+			return;
+		}
+
+		uint32_t window = 1;
+		if (window_field)
+		{
+			std::optional<std::string_view> text   = percent_decode(*window_field, window_buffer, true);
+			bool							parsed = false;
+			if (text)
+			{
+				auto [end, error] = std::from_chars(text->data(), text->data() + text->size(), window);
+				parsed			  = error == std::errc() && end == text->data() + text->size();
+			}
+
+			if (!parsed)
+			{
+				this->write_response(connection, 400, R"({"error":"malformed window"})", keep_alive);
+				return;
+			}
+		}
+
+		if (!m_totp_manager->get_account_parameters(*account))
+		{
+			this->write_response(connection, 404, R"({"error":"unknown account"})", keep_alive);
+			return;
+		}
+
+		std::optional<int32_t> offset = m_totp_manager->verify(*account, *code, unix_time, window);
+		if (!offset)
+		{
+			this->write_response(connection, 403, R"({"valid":false})", keep_alive);
+			return;
+		}
+
+		char* end = fmt::format_to(reply, R"({{"valid":true,"offset":{}}})", *offset);
+		this->write_response(connection, 200, std::string_view(reply, end), keep_alive);
+	}
+	else
+	{
+		this->write_response(connection, 404, R"({"error":"not found"})", keep_alive);
+	}
+}
+
+void TOTPHttpServer::process_requests(Connection& connection) const
+{
+	size_t consumed = 0;
+
+	// Refuses the connection's next request; the reply closes it once sent.
+	auto reject = [&](int status, std::string_view body) { this->write_response(connection, status, body, false); };
+
+	while (!connection.close_after_write && connection.output.size() - connection.output_size >= d_http_max_response_size)
+	{
+		const std::string_view input(connection.input.data() + consumed, connection.input_size - consumed);
+
+		const size_t head_size = input.find("\r\n\r\n");
+		if (head_size == std::string_view::npos)
+		{
+			if (consumed == 0 && connection.input_size == connection.input.size())
+			{
+				reject(431, R"({"error":"request head too large"})");
+			}
+			break;
+		}
+
+		const std::string_view head			= input.substr(0, head_size);
+		const size_t		   line_end		= head.find("\r\n");
+		const std::string_view request_line = head.substr(0, line_end);
+		std::string_view	   headers		= line_end == std::string_view::npos ? std::string_view() : head.substr(line_end + 2);
+
+		const size_t method_end = request_line.find(' ');
+		const size_t target_end = method_end == std::string_view::npos ? method_end : request_line.find(' ', method_end + 1);
+		if (target_end == std::string_view::npos || !request_line.substr(target_end + 1).starts_with("HTTP/1."))
+		{
+			reject(400, R"({"error":"malformed request line"})");
+			break;
+		}
+
+		const std::string_view method	  = request_line.substr(0, method_end);
+		const std::string_view target	  = request_line.substr(method_end + 1, target_end - method_end - 1);
+		bool				   keep_alive = request_line.substr(target_end + 1) != "HTTP/1.0";
+
+		size_t content_length = 0;
+		bool   framed		  = true;
+		bool   chunked		  = false;
+		bool   authorized	  = false;
+		while (!headers.empty())
+		{
+			const size_t		   end	 = headers.find("\r\n");
+			const std::string_view line	 = headers.substr(0, end);
+			const size_t		   colon = line.find(':');
+			headers.remove_prefix(end == std::string_view::npos ? headers.size() : end + 2);
+
+			if (colon == std::string_view::npos)
+			{
+				continue;
+			}
+
+			const std::string_view name	 = line.substr(0, colon);
+			const std::string_view value = trim(line.substr(colon + 1));
+			if (iequals(name, "Content-Length"))
+			{
+				auto [number_end, error] = std::from_chars(value.data(), value.data() + value.size(), content_length);
+				framed					 = framed && error == std::errc() && number_end == value.data() + value.size();
+			}
+			else if (iequals(name, "Connection"))
+			{
+				keep_alive = iequals(value, "close") ? false : iequals(value, "keep-alive") ? true : keep_alive;
+			}
+			else if (iequals(name, "Transfer-Encoding"))
+			{
+				chunked = true;
+			}
+			else if (iequals(name, "Authorization") && value.size() > 7 && iequals(value.substr(0, 7), "Bearer "))
+			{
+				authorized = authorized || (!m_token.empty() && same_secret(trim(value.substr(7)), m_token));
+			}
+		}
+
+		if (!framed)
+		{
+			reject(400, R"({"error":"malformed content length"})");
+			break;
+		}
+
+		if (chunked)
+		{
+			reject(501, R"({"error":"transfer encodings are not supported"})");
+			break;
+		}
+
+		const size_t body_offset = head_size + 4;
+		if (content_length > connection.input.size() - body_offset)
+		{
+			reject(413, R"({"error":"request too large"})");
+			break;
+		}
+
+		if (body_offset + content_length > input.size())
+		{
+			break;
+		}
+
+		if (authorized)
+		{
+			this->handle_request(connection, method, target, input.substr(body_offset, content_length), keep_alive);
+		}
+		else
+		{
+			this->write_response(connection, 401, R"({"error":"unauthorized"})", keep_alive);
+		}
+		consumed += body_offset + content_length;
+		++connection.progress;
+	}
+
+	// Keep the unanswered tail at the front so the buffer never has to grow.
+	std::memmove(connection.input.data(), connection.input.data() + consumed, connection.input_size - consumed);
+	connection.input_size -= consumed;
+}
+
+#ifdef _WIN32
+
+TOTPHttpServer::~TOTPHttpServer()
+{}
+
+bool TOTPHttpServer::listen(const std::string&, uint16_t, size_t)
+{
+	SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "The HTTP server is not supported on this platform.");
+	return false;
+}
+
+bool TOTPHttpServer::run()
+{
+	return false;
+}
+
+bool TOTPHttpServer::run_worker(Worker&) const
+{
+	return false;
+}
+
+void TOTPHttpServer::accept_connections(Worker&) const
+{}
+
+bool TOTPHttpServer::read_connection(Connection&) const
+{
+	return false;
+}
+
+bool TOTPHttpServer::flush_connection(Worker&, Connection&) const
+{
+	return false;
+}
+
+void TOTPHttpServer::close_connection(Worker&, Connection&) const
+{}
+
+void TOTPHttpServer::file_timeout(Worker&, Connection&) const
+{}
+
+void TOTPHttpServer::expire_connections(Worker&) const
+{}
+
+#else
+
+TOTPHttpServer::~TOTPHttpServer()
+{
+	for (Worker& worker : m_workers)
+	{
+		if (worker.listen_fd >= 0)
+		{
+			close(worker.listen_fd);
+		}
+	}
+
+	if (m_stop_fd >= 0)
+	{
+		close(m_stop_fd);
+	}
+}
+
+bool TOTPHttpServer::listen(const std::string& address, uint16_t port, size_t thread_count)
+{
+	sockaddr_storage storage	= {};
+	socklen_t		 length		= 0;
+	auto*			 ipv4		= reinterpret_cast<sockaddr_in*>(&storage);
+	auto*			 ipv6		= reinterpret_cast<sockaddr_in6*>(&storage);
+	in_port_t*		 port_field = nullptr;
+
+	if (inet_pton(AF_INET, address.c_str(), &ipv4->sin_addr) == 1)
+	{
+		ipv4->sin_family = AF_INET;
+		length			 = sizeof(sockaddr_in);
+		port_field		 = &ipv4->sin_port;
+	}
+	else if (inet_pton(AF_INET6, address.c_str(), &ipv6->sin6_addr) == 1)
+	{
+		ipv6->sin6_family = AF_INET6;
+		length			  = sizeof(sockaddr_in6);
+		port_field		  = &ipv6->sin6_port;
+	}
+	else
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("'{}' is not an IPv4 or IPv6 address.", address));
+		return false;
+	}
+
+	// Even on loopback every local user could connect; the daemon socket and code table are owner-only.
+	if (m_token.empty())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Refusing to serve codes on {} without authentication; set http.token.", address));
+		return false;
+	}
+
+	std::vector<int> cpus;
+	cpu_set_t		 allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+	{
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+		{
+			if (CPU_ISSET(cpu, &allowed))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+	}
+
+	if (cpus.empty())
+	{
+		cpus.push_back(-1);
+	}
+
+	m_workers.resize(thread_count == 0 ? cpus.size() : thread_count);
+	m_port = port;
+
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		Worker& worker = m_workers[i];
+		worker.cpu	   = cpus[i % cpus.size()];
+
+		// Every worker binds the same port; the kernel hashes each new connection to one of them.
+		int enabled		 = 1;
+		worker.listen_fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		*port_field		 = htons(m_port);
+
+		const bool bound = worker.listen_fd >= 0 && setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) == 0
+						   && setsockopt(worker.listen_fd, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) == 0
+						   && bind(worker.listen_fd, reinterpret_cast<const sockaddr*>(&storage), length) == 0
+						   && ::listen(worker.listen_fd, SOMAXCONN) == 0;
+		if (!bound)
+		{
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to listen on {} port {}: {}", address, m_port, strerror(errno)));
+			return false;
+		}
+
+		// With port 0 the first bind picks the port the other workers then share.
+		if (i == 0)
+		{
+			sockaddr_storage bound_address		  = {};
+			socklen_t		 bound_address_length = sizeof(bound_address);
+			getsockname(worker.listen_fd, reinterpret_cast<sockaddr*>(&bound_address), &bound_address_length);
+			m_port = ntohs(bound_address.ss_family == AF_INET ? reinterpret_cast<sockaddr_in*>(&bound_address)->sin_port
+															  : reinterpret_cast<sockaddr_in6*>(&bound_address)->sin6_port);
+		}
+	}
+
+	m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_stop_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create the HTTP server stop event: {}", strerror(errno)));
+		return false;
+	}
+
+	SPD_INFO_CLASS(COMMON::d_settings_group_utils,
+				   fmt::format("HTTP server listening on {} port {} with {} worker(s).", address, m_port, m_workers.size()));
+	return true;
+}
+
+bool TOTPHttpServer::run()
+{
+	if (m_workers.empty() || m_stop_fd < 0)
+	{
+		return false;
+	}
+
+	// Blocked before the workers start so they inherit the mask and only the signalfd sees the signals.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to set up the HTTP server signal handler: {}", strerror(errno)));
+		return false;
+	}
+
+	// The stop event is never read, so once written it stays readable for every worker.
+	const uint64_t	  stop = 1;
+	std::atomic<bool> healthy {true};
+
+	std::vector<std::thread> threads;
+	threads.reserve(m_workers.size());
+	for (Worker& worker : m_workers)
+	{
+		threads.emplace_back([this, &worker, &healthy, &stop]() {
+			if (!this->run_worker(worker))
+			{
+				healthy.store(false);
+				[[maybe_unused]] ssize_t size = write(m_stop_fd, &stop, sizeof(stop));
+			}
+		});
+	}
+
+	pollfd waits[] = {{signal_fd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}};
+	while (poll(waits, std::size(waits), -1) < 0 && errno == EINTR)
+	{}
+
+	signalfd_siginfo info;
+	[[maybe_unused]] ssize_t read_size	= read(signal_fd, &info, sizeof(info));
+	[[maybe_unused]] ssize_t write_size = write(m_stop_fd, &stop, sizeof(stop));
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	close(signal_fd);
+	SPD_INFO_CLASS(COMMON::d_settings_group_utils, "HTTP server stopped.");
+	return healthy.load();
+}
+
+bool TOTPHttpServer::run_worker(Worker& worker) const
+{
+	if (worker.cpu >= 0)
+	{
+		cpu_set_t cpu;
+		CPU_ZERO(&cpu);
+		CPU_SET(worker.cpu, &cpu);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+	}
+
+	worker.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (worker.epoll_fd < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create an HTTP worker event loop: {}", strerror(errno)));
+		return false;
+	}
+
+	// Ticks once a second to close stalled connections.
+	const itimerspec tick = {{1, 0}, {1, 0}};
+	worker.timer_fd		  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (worker.timer_fd < 0 || timerfd_settime(worker.timer_fd, 0, &tick, nullptr) < 0)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to create an HTTP worker timer: {}", strerror(errno)));
+		close(worker.epoll_fd);
+		return false;
+	}
+
+	worker.now			 = monotonic_seconds();
+	worker.timer_checked = worker.now;
+
+	// The listener is tagged with its worker, the timer with its descriptor and the stop event with
+	// null; everything else is a Connection.
+	epoll_event listen_event = {};
+	listen_event.events		 = EPOLLIN;
+	listen_event.data.ptr	 = &worker;
+	epoll_event timer_event	 = {};
+	timer_event.events		 = EPOLLIN;
+	timer_event.data.ptr	 = &worker.timer_fd;
+	epoll_event stop_event	 = {};
+	stop_event.events		 = EPOLLIN;
+	stop_event.data.ptr		 = nullptr;
+	epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, worker.listen_fd, &listen_event);
+	epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, worker.timer_fd, &timer_event);
+	epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, m_stop_fd, &stop_event);
+
+	bool		running = true;
+	bool		healthy = true;
+	epoll_event events[d_max_epoll_events];
+
+	while (running)
+	{
+		int ready = epoll_wait(worker.epoll_fd, events, d_max_epoll_events, -1);
+		if (ready < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("HTTP worker event loop failed: {}", strerror(errno)));
+			healthy = false;
+			break;
+		}
+
+		worker.now = monotonic_seconds();
+
+		bool timer_due = false;
+		for (int i = 0; i < ready; ++i)
+		{
+			if (events[i].data.ptr == nullptr)
+			{
+				running = false;
+				continue;
+			}
+
+			if (events[i].data.ptr == &worker)
+			{
+				this->accept_connections(worker);
+				continue;
+			}
+
+			if (events[i].data.ptr == &worker.timer_fd)
+			{
+				uint64_t expirations;
+				[[maybe_unused]] ssize_t size = read(worker.timer_fd, &expirations, sizeof(expirations));
+
+				timer_due = true;
+				continue;
+			}
+
+			Connection&	   connection = *static_cast<Connection*>(events[i].data.ptr);
+			const uint64_t progress	  = connection.progress;
+			const bool	   was_idle	  = connection.input_size == 0;
+
+			bool open = true;
+			if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+			{
+				open = this->read_connection(connection);
+			}
+
+			// Keep answering while replies drain immediately; stop once the socket pushes back.
+			bool sent = true;
+			while (sent)
+			{
+				const size_t queued = connection.output_size;
+				this->process_requests(connection);
+				const bool answered = connection.output_size != queued;
+
+				sent = this->flush_connection(worker, connection);
+				if (!answered || connection.output_size != 0)
+				{
+					break;
+				}
+			}
+
+			// Closing with unread requests would reset the connection and could destroy the final reply in
+			// flight, so end our side first and close once the client has seen it and hung up.
+			if (sent && open && connection.close_after_write && connection.output_size == 0 && !connection.shut_down)
+			{
+				shutdown(connection.fd, SHUT_WR);
+				connection.shut_down = true;
+			}
+
+			if (!sent || !open)
+			{
+				this->close_connection(worker, connection);
+				continue;
+			}
+
+			// Only the start of a request, an answer or a reply draining moves the deadline, so a client
+			// trickling in a request byte by byte still runs out of time.
+			if (connection.input_size == 0 && connection.output_size == 0)
+			{
+				connection.deadline = worker.now + d_http_keep_alive_timeout_s;
+			}
+			else if (connection.progress != progress || was_idle)
+			{
+				connection.deadline = worker.now + d_http_request_timeout_s;
+			}
+
+			if (connection.deadline < connection.filed)
+			{
+				this->file_timeout(worker, connection);
+			}
+		}
+
+		// Only once the batch is done: later events in it may belong to connections expiry would close.
+		if (timer_due)
+		{
+			this->expire_connections(worker);
+		}
+	}
+
+	for (const std::unique_ptr<Connection>& connection : worker.connections)
+	{
+		if (connection->fd >= 0)
+		{
+			this->close_connection(worker, *connection);
+		}
+	}
+
+	close(worker.timer_fd);
+	close(worker.epoll_fd);
+	worker.timer_fd = -1;
+	worker.epoll_fd = -1;
+	return healthy;
+}
+
+void TOTPHttpServer::accept_connections(Worker& worker) const
+{
+	while (true)
+	{
+		int fd = accept4(worker.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to accept an HTTP client: {}", strerror(errno)));
+			}
+			return;
+		}
+
+		if (worker.connection_count == d_http_max_connections_per_worker)
+		{
+			close(fd);
+			continue;
+		}
+
+		// Replies go out in one send per batch, so Nagle would only add delay.
+		int enabled = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+
+		// Connections, and their buffers, are recycled; the pool only grows to the peak connection count.
+		if (worker.idle_connections.empty())
+		{
+			worker.connections.push_back(std::make_unique<Connection>());
+			worker.idle_connections.push_back(worker.connections.back().get());
+		}
+
+		Connection* connection = worker.idle_connections.back();
+		connection->fd		   = fd;
+
+		epoll_event event = {};
+		event.events	  = EPOLLIN | EPOLLRDHUP;
+		event.data.ptr	  = connection;
+		if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+		{
+			close(fd);
+			connection->fd = -1;
+			continue;
+		}
+
+		worker.idle_connections.pop_back();
+		++worker.connection_count;
+
+		// A new connection gets the request timeout to send its first request.
+		++connection->generation;
+		connection->deadline = worker.now + d_http_request_timeout_s;
+		this->file_timeout(worker, *connection);
+	}
+}
+
+bool TOTPHttpServer::read_connection(Connection& connection) const
+{
+	while (connection.input_size < connection.input.size())
+	{
+		// Nothing after the final reply is answered; discard it while waiting for the client to hang up.
+		if (connection.close_after_write)
+		{
+			connection.input_size = 0;
+		}
+
+		ssize_t size = recv(connection.fd, connection.input.data() + connection.input_size, connection.input.size() - connection.input_size, 0);
+		if (size > 0)
+		{
+			connection.input_size += static_cast<size_t>(size);
+			continue;
+		}
+
+		if (size < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		return size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+
+	// A full buffer is drained by process_requests(); the rest is read on the next wakeup.
+	return true;
+}
+
+bool TOTPHttpServer::flush_connection(Worker& worker, Connection& connection) const
+{
+	size_t sent = 0;
+
+	while (sent < connection.output_size)
+	{
+		ssize_t size = send(connection.fd, connection.output.data() + sent, connection.output_size - sent, MSG_NOSIGNAL);
+		if (size < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				return false;
+			}
+
+			break;
+		}
+
+		sent += static_cast<size_t>(size);
+	}
+
+	std::memmove(connection.output.data(), connection.output.data() + sent, connection.output_size - sent);
+	connection.output_size -= sent;
+	connection.progress += sent != 0;
+
+	// While replies are backed up, wait for writability instead of reading requests there is no room to answer.
+	const bool waiting_for_write = connection.output_size != 0;
+	if (waiting_for_write != connection.waiting_for_write)
+	{
+		epoll_event event = {};
+		event.events	  = waiting_for_write ? static_cast<uint32_t>(EPOLLOUT) : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP);
+		event.data.ptr	  = &connection;
+		epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+
+		connection.waiting_for_write = waiting_for_write;
+	}
+
+	return true;
+}
+
+void TOTPHttpServer::close_connection(Worker& worker, Connection& connection) const
+{
+	epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+	close(connection.fd);
+
+	connection.fd				 = -1;
+	connection.input_size		 = 0;
+	connection.output_size		 = 0;
+	connection.waiting_for_write = false;
+	connection.close_after_write = false;
+	connection.shut_down		 = false;
+
+	worker.idle_connections.push_back(&connection);
+	--worker.connection_count;
+}
+
+void TOTPHttpServer::file_timeout(Worker& worker, Connection& connection) const
+{
+	connection.filed = connection.deadline;
+	worker.timer_wheel[connection.deadline % d_http_timer_wheel_size].push_back({&connection, connection.generation, connection.deadline});
+}
+
+void TOTPHttpServer::expire_connections(Worker& worker) const
+{
+	// After a long stall every slot is due; one turn of the wheel covers them all.
+	worker.timer_checked = std::max(worker.timer_checked, worker.now - std::min(worker.now, d_http_timer_wheel_size));
+
+	while (worker.timer_checked < worker.now)
+	{
+		std::vector<TimerEntry>& slot = worker.timer_wheel[++worker.timer_checked % d_http_timer_wheel_size];
+
+		for (size_t i = 0; i < slot.size();)
+		{
+			const TimerEntry entry		= slot[i];
+			Connection&		 connection = *entry.connection;
+
+			// Entries of closed or refiled connections are dropped, due connections closed and ones whose
+			// deadline moved on filed under it. Removal swaps in the last entry, which is examined next.
+			const bool live = connection.fd >= 0 && connection.generation == entry.generation && connection.filed == entry.deadline;
+			if (live && connection.deadline > worker.now && connection.deadline == entry.deadline)
+			{
+				++i;
+				continue;
+			}
+
+			slot[i] = slot.back();
+			slot.pop_back();
+
+			if (live && connection.deadline <= worker.now)
+			{
+				this->close_connection(worker, connection);
+			}
+			else if (live)
+			{
+				this->file_timeout(worker, connection);
+			}
+		}
+	}
+}
+
+#endif
+
+} // namespace UTILS
@@ -0,0 +1,138 @@
+#ifndef TOTP_HTTP_SERVER_HPP
+#define TOTP_HTTP_SERVER_HPP
+
+#include "totp_manager.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace UTILS
+{
+// Each connection owns fixed buffers: the input holds the largest request accepted (head and body),
+// the output queues pipelined replies. A connection stops parsing while less than one worst-case
+// reply fits and stops reading while replies are backed up.
+constexpr size_t d_http_input_buffer_size		   = 8192;
+constexpr size_t d_http_output_buffer_size		   = 16384;
+constexpr size_t d_http_max_response_size		   = 2048;
+constexpr size_t d_http_max_account_size		   = 128;
+constexpr size_t d_http_max_connections_per_worker = 4096;
+
+// A request must arrive in full within d_http_request_timeout_s of its first byte, and a reply that
+// stops draining may stall that long too; between requests a connection may sit idle for
+// d_http_keep_alive_timeout_s. Stalled connections are closed, checked once a second.
+constexpr uint64_t d_http_request_timeout_s	   = 10;
+constexpr uint64_t d_http_keep_alive_timeout_s = 30;
+
+// Seconds the deadline wheel spans; must exceed both timeouts.
+constexpr size_t d_http_timer_wheel_size = 64;
+
+// Serves codes over HTTP/1.1 for consumers that cannot use the daemon socket.
+//
+//   GET /totp/{account}                        -> 200 {"account":..,"code":..,"digits":..,"valid_until":..}
+//   GET /verify?account=..&code=..[&window=..] -> 200 {"valid":true,"offset":..} or 403 {"valid":false}
+//   POST /verify with the same fields as an application/x-www-form-urlencoded body
+// Unknown accounts answer 404, missing fields 400. Every request must carry "Authorization: Bearer
+// <token>" or is answered 401. Connections are kept alive unless the client asks otherwise or stalls,
+// and requests may be pipelined.
+//
+// Workers are thread-per-core and share nothing but the TOTPManager: each is pinned to a core and has
+// its own SO_REUSEPORT listener (the kernel spreads connections between them), epoll loop and pool of
+// recycled connections. Requests read the manager's snapshot, its code cache and the replay cache,
+// none of which takes a mutex, so workers never wait on each other.
+class TOTPHttpServer
+{
+public:
+	// listen() refuses to start with an empty token.
+	TOTPHttpServer(std::shared_ptr<TOTPManager> totp_manager, std::string token);
+	~TOTPHttpServer();
+
+	TOTPHttpServer(const TOTPHttpServer&)			 = delete;
+	TOTPHttpServer& operator=(const TOTPHttpServer&) = delete;
+
+	// Opens one listener per worker. thread_count 0 uses every core this process may run on; port 0
+	// picks a free port, see port().
+	bool	 listen(const std::string& address, uint16_t port, size_t thread_count = 0);
+	uint16_t port() const;
+
+	// Runs the workers until SIGINT or SIGTERM arrives. Returns false if any worker failed.
+	bool run();
+
+private:
+	struct Connection
+	{
+		int		 fd				   = -1;
+		size_t	 input_size		   = 0;
+		size_t	 output_size	   = 0;
+		bool	 waiting_for_write = false;
+		bool	 close_after_write = false;
+		bool	 shut_down		   = false;
+		uint64_t deadline		   = 0; // monotonic seconds
+		uint64_t filed			   = 0; // the deadline of its live entry in the timer wheel
+		uint64_t generation		   = 0; // bumped on every reuse, so wheel entries for an earlier client are skipped
+		uint64_t progress		   = 0; // requests answered plus sends that made headway
+
+		std::array<char, d_http_input_buffer_size>	input;
+		std::array<char, d_http_output_buffer_size> output;
+	};
+
+	struct TimerEntry
+	{
+		Connection* connection;
+		uint64_t	generation;
+		uint64_t	deadline;
+	};
+
+	struct Worker
+	{
+		int		 listen_fd		  = -1;
+		int		 epoll_fd		  = -1;
+		int		 timer_fd		  = -1;
+		int		 cpu			  = -1;
+		size_t	 connection_count = 0;
+		uint64_t now			  = 0; // monotonic seconds, as of the last wakeup
+
+		std::vector<std::unique_ptr<Connection>> connections;
+		std::vector<Connection*>				 idle_connections;
+
+		// Every open connection has one live entry, in the slot of the deadline it was filed under. A
+		// deadline that moves later is noticed when that slot comes up and filed again; one that moves
+		// earlier is filed at once, and the entry it replaces is dropped when its slot comes up.
+		std::array<std::vector<TimerEntry>, d_http_timer_wheel_size> timer_wheel;
+		uint64_t													 timer_checked = 0;
+	};
+
+	bool run_worker(Worker& worker) const;
+	void accept_connections(Worker& worker) const;
+	bool read_connection(Connection& connection) const;
+	bool flush_connection(Worker& worker, Connection& connection) const;
+	void close_connection(Worker& worker, Connection& connection) const;
+
+	// Files connection under its current deadline, replacing its live entry.
+	void file_timeout(Worker& worker, Connection& connection) const;
+	// Closes the connections whose deadline passed, walking the wheel up to worker.now.
+	void expire_connections(Worker& worker) const;
+
+	// Answers every complete request that has room in the output buffer. A request that cannot be
+	// framed gets an error reply that closes the connection once sent.
+	void process_requests(Connection& connection) const;
+	void handle_request(Connection&		 connection,
+						std::string_view method,
+						std::string_view target,
+						std::string_view body,
+						bool			 keep_alive) const;
+	void write_response(Connection& connection, int status, std::string_view body, bool keep_alive) const;
+
+	std::shared_ptr<TOTPManager> m_totp_manager;
+	std::string					 m_token;
+	std::vector<Worker>			 m_workers;
+
+	uint16_t m_port	   = 0;
+	int		 m_stop_fd = -1;
+};
+
+} // namespace UTILS
+
+#endif // TOTP_HTTP_SERVER_HPP
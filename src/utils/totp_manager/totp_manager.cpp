@@ -3,30 +3,14 @@
 #include "settings_manager.hpp"
 #include "spdlog_wrapper.hpp"
 
-#include <cctype>
-#include <libcppotp/bytes.h>
-#include <libcppotp/otp.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iterator>
+#include <ostream>
 #include <string>
 
-namespace
-{
-std::string normalizedBase32String(const std::string& unnorm)
-{
-	std::string ret;
-	for (char c : unnorm)
-	{
-		if (c >= 'a' && c <= 'z')
-		{
-			ret.push_back(std::toupper(c));
-		}
-		else if ((c >= 'A' && c <= 'Z') || (c >= '2' && c <= '7'))
-		{
-			ret.push_back(c);
-		}
-	}
-	return ret;
-}
-} // namespace
+static_assert(UTILS::d_replay_ring_size > 2 * UTILS::d_max_verify_window + 1, "Replay ring must outlive the verification window");
 
 namespace UTILS
 {
@@ -39,64 +23,542 @@ std::string_view TOTPManager::get_manager_name() const
 void TOTPManager::initialize()
 {
 	m_settings_manager = UTILS::SettingsManager::instance();
+
+	if (!totp_self_test())
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, "TOTP engine failed the RFC 6238 self-test.");
+	}
+
 	load_account();
+
+	// Edits made to the settings file while running (see SettingsManager::watch_settings) publish a
+	// new snapshot; the code caches notice the new snapshot and start over.
+	m_settings_subscription = m_settings_manager->subscribe("totp", [this](const std::vector<std::string>&) { this->load_account(); });
 }
 
 TOTPManager::~TOTPManager()
-{}
+{
+	if (m_settings_manager)
+	{
+		m_settings_manager->unsubscribe(m_settings_subscription);
+	}
+}
 
 void TOTPManager::load_account()
 {
-	m_account_name	 = m_settings_manager->get_setting<std::string>("totp.account_name", "");
-	m_account_secret = m_settings_manager->get_setting<std::string>("totp.secret", "");
+	std::lock_guard<std::mutex> lock(m_totp_mutex);
+
+	auto			   next				  = std::make_shared<AccountSnapshot>();
+	AccountStore&	   store			  = next->accounts;
+	std::string&	   account_name		  = next->account_name;
+	AccountParameters& default_parameters = next->default_parameters;
+
+	default_parameters.period = m_settings_manager->get_setting<uint32_t>("totp.period", 30);
+	default_parameters.digits = m_settings_manager->get_setting<uint32_t>("totp.digits", 6);
+
+	std::string default_algorithm = m_settings_manager->get_setting<std::string>("totp.algorithm", "SHA1");
+	if (auto parsed = algorithm_from_string(default_algorithm))
+	{
+		default_parameters.algorithm = *parsed;
+	}
+	else
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Unsupported default algorithm '{}', using SHA1.", default_algorithm));
+		default_parameters.algorithm = TOTPAlgorithm::SHA1;
+	}
+
+	// The vault is opened for the duration of each operation only, as it is locked while open.
+	AccountVault vault;
+	m_vault_path = m_settings_manager->get_setting<std::string>("totp.vault", "");
+	if (!m_vault_path.empty() && !vault.open(m_vault_path))
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils, "Using the accounts in the settings file instead of the account vault.");
+		m_vault_path.clear();
+	}
+
+	toml::table				 accounts = m_settings_manager->get_table("totp.accounts");
+	std::vector<std::string> imported;
+	m_rejected_accounts.clear();
+	for (auto&& [key, node] : accounts)
+	{
+		const toml::table* account = node.as_table();
+		if (!account)
+		{
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Ignoring malformed account entry '{}'.", key.str()));
+			m_rejected_accounts.emplace_back(key.str());
+			continue;
+		}
+
+		AccountParameters parameters = default_parameters;
+		parameters.period = (*account)["period"].value_or(parameters.period);
+		parameters.digits = (*account)["digits"].value_or(parameters.digits);
+
+		std::string algorithm = (*account)["algorithm"].value_or(std::string(algorithm_to_string(parameters.algorithm)));
+		if (auto parsed = algorithm_from_string(algorithm))
+		{
+			parameters.algorithm = *parsed;
+		}
+		else
+		{
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Unsupported algorithm '{}' for account '{}'.", algorithm, key.str()));
+			m_rejected_accounts.emplace_back(key.str());
+			continue;
+		}
+
+		// Entries in the settings file, including edits made while running, move into the vault once the
+		// store has accepted them. One the store rejects stays in the settings file to be corrected, and
+		// one the vault cannot take is served from the settings file and stays there.
+		std::string secret = (*account)["secret"].value_or(std::string());
+		if (store.add(key.str(), secret, parameters) == d_invalid_account_id)
+		{
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Leaving invalid account entry '{}' in the settings file.", key.str()));
+			m_rejected_accounts.emplace_back(key.str());
+			continue;
+		}
+
+		if (vault.is_open() && vault.put(key.str(), secret, parameters))
+		{
+			imported.emplace_back(key.str());
+		}
+	}
+
+	if (vault.is_open())
+	{
+		vault.for_each([&store](const VaultAccount& account) {
+			if (store.find(account.name) == d_invalid_account_id)
+			{
+				store.add(account.name, account.secret, account.parameters);
+			}
+		});
+	}
+
+	account_name = m_settings_manager->get_setting<std::string>("totp.account_name", "");
+
+	// Single-account configs keep their secret in totp.secret; fold it into the store.
+	std::string legacy_secret = m_settings_manager->get_setting<std::string>("totp.secret", "");
+	if (!account_name.empty() && !legacy_secret.empty() && store.find(account_name) == d_invalid_account_id
+		&& store.add(account_name, legacy_secret, default_parameters) != d_invalid_account_id && vault.is_open())
+	{
+		vault.put(account_name, legacy_secret, default_parameters);
+	}
+	vault.close();
+
+	if (store.find(account_name) == d_invalid_account_id)
+	{
+		account_name = store.empty() ? "" : std::string(store.get_name(0));
+	}
+
+	// The replay cache outlives snapshots and is keyed by serial, so a reload must not move serials
+	// to other accounts.
+	store.carry_serials(this->snapshot()->accounts);
+
+	this->publish(std::move(next));
+
+	// Drop the entries now in the vault from the settings file.
+	if (!imported.empty())
+	{
+		for (const std::string& name : imported)
+		{
+			accounts.erase(name);
+		}
+
+		m_settings_manager->set_setting("totp.accounts", std::move(accounts));
+		m_settings_manager->save_settings();
+	}
 }
 
 void TOTPManager::save_account()
 {
 	std::lock_guard<std::mutex> lock(m_totp_mutex);
 
-	if (!m_account_name.empty() && !m_account_secret.empty())
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+	const AccountStore&					   store   = current->accounts;
+
+	// With a vault, set_account() and clear_account() have already written their change to it; only
+	// accounts it does not hold as they are, such as ones load_account() could not import, stay here.
+	AccountVault vault;
+	const bool	 vaulted = !m_vault_path.empty() && vault.open(m_vault_path);
+
+	// Entries load_account() rejected are not in the store; keep them as written until one is replaced.
+	toml::table				 accounts = m_settings_manager->get_table("totp.accounts");
+	std::vector<std::string> replaced;
+	for (auto&& [key, node] : accounts)
 	{
-		m_settings_manager->set_setting("totp.account_name", m_account_name);
-		m_settings_manager->set_setting("totp.secret", m_account_secret);
+		if (std::find(m_rejected_accounts.begin(), m_rejected_accounts.end(), key.str()) == m_rejected_accounts.end()
+			|| store.find(key.str()) != d_invalid_account_id)
+		{
+			replaced.emplace_back(key.str());
+		}
+	}
 
-		m_settings_manager->save_settings();
+	for (const std::string& name : replaced)
+	{
+		accounts.erase(name);
+	}
+
+	for (AccountId id = 0; id < store.size(); ++id)
+	{
+		AccountParameters			parameters = store.get_parameters(id);
+		std::optional<VaultAccount> stored	   = vaulted ? vault.find(store.get_name(id)) : std::nullopt;
+		if (stored && stored->secret == store.get_secret(id) && stored->parameters.period == parameters.period
+			&& stored->parameters.digits == parameters.digits && stored->parameters.algorithm == parameters.algorithm)
+		{
+			continue;
+		}
+
+		accounts.insert_or_assign(store.get_name(id),
+								  toml::table {
+									  {"secret", store.get_secret(id)},
+									  {"period", static_cast<int64_t>(parameters.period)},
+									  {"digits", static_cast<int64_t>(parameters.digits)},
+									  {"algorithm", std::string(algorithm_to_string(parameters.algorithm))},
+								  });
+	}
+
+	vault.close();
+
+	// Running processes read the vault again only when their settings watcher fires, so a vault
+	// change also writes a new revision here, which reaches them even when nothing else changed.
+	if (!m_vault_path.empty())
+	{
+		m_settings_manager->set_setting("totp.vault_revision",
+										static_cast<int64_t>(std::chrono::system_clock::now().time_since_epoch().count()));
+	}
+
+	// The legacy single secret has been folded into totp.accounts by load_account().
+	m_settings_manager->set_setting("totp.account_name", current->account_name);
+	m_settings_manager->set_setting("totp.secret", std::string());
+	m_settings_manager->set_setting("totp.accounts", std::move(accounts));
+
+	m_settings_manager->save_settings();
+}
+
+std::shared_ptr<const AccountSnapshot> TOTPManager::snapshot() const
+{
+	return m_snapshot.load(std::memory_order_acquire);
+}
+
+void TOTPManager::publish(std::shared_ptr<AccountSnapshot> next)
+{
+	next->codes.reset(next->accounts.size());
+	m_snapshot.store(std::move(next), std::memory_order_release);
+}
+
+void TOTPManager::sync_code_scheduler(const std::shared_ptr<const AccountSnapshot>& snapshot) const
+{
+	// Ids are only meaningful within one snapshot; start a fresh schedule when it changes.
+	if (m_code_scheduler_source != snapshot)
+	{
+		m_code_scheduler.reset(snapshot->accounts.size());
+		m_code_scheduler_source = snapshot;
 	}
 }
 
+uint32_t TOTPManager::cached_code(const AccountSnapshot& snapshot, AccountId id, uint64_t unix_time) const
+{
+	// Lock-free: a miss computes the code and leaves caching it to the next precompute_codes().
+	std::optional<uint32_t> code = snapshot.codes.lookup(id, unix_time / snapshot.accounts.get_parameters(id).period);
+
+	return code ? *code : snapshot.accounts.generate(id, unix_time);
+}
+
+size_t TOTPManager::generate_from(const AccountSnapshot& snapshot, std::string_view account_name, uint64_t unix_time, std::span<char> output) const
+{
+	const AccountStore& accounts = snapshot.accounts;
+
+	AccountId id = accounts.find(account_name);
+	if (id == d_invalid_account_id)
+	{
+		// Debug only: the name comes from clients, who could otherwise fill the log.
+		SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to generate TOTP for account '{}': account not found", account_name));
+		return 0;
+	}
+
+	return format_code(this->cached_code(snapshot, id, unix_time), accounts.get_parameters(id).digits, output);
+}
+
+std::optional<uint64_t> TOTPManager::precompute_codes(uint64_t unix_time) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+	std::lock_guard<std::mutex>			   lock(m_code_scheduler_mutex);
+	this->sync_code_scheduler(current);
+
+	m_code_scheduler.advance(current->accounts, current->codes, unix_time);
+	return m_code_scheduler.next_rollover();
+}
+
 std::string TOTPManager::generate_totp()
 {
-	std::string current_name;
-	std::string current_secret;
+	char   buffer[d_max_code_digits];
+	size_t size = generate_totp(static_cast<uint64_t>(time(NULL)), buffer);
+
+	return std::string(buffer, size);
+}
+
+std::string TOTPManager::generate_totp(std::string_view account_name)
+{
+	char   buffer[d_max_code_digits];
+	size_t size = generate_totp(account_name, static_cast<uint64_t>(time(NULL)), buffer);
+
+	return std::string(buffer, size);
+}
+
+std::optional<uint32_t> TOTPManager::generate_code(std::string_view account_name, uint64_t unix_time) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
 
-	if (m_account_secret.empty())
+	AccountId id = current->accounts.find(account_name);
+	if (id == d_invalid_account_id)
+	{
+		return std::nullopt;
+	}
+
+	return this->cached_code(*current, id, unix_time);
+}
+
+size_t TOTPManager::generate_totp(uint64_t unix_time, std::span<char> output) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	if (current->account_name.empty())
 	{
 		SPD_WARN_CLASS(COMMON::d_settings_group_utils, "No TOTP secret configured.");
-		return "";
+		return 0;
 	}
-	current_name   = m_account_name;
-	current_secret = m_account_secret;
 
-	std::string normalizedKey = normalizedBase32String(current_secret);
-	try
+	return generate_from(*current, current->account_name, unix_time, output);
+}
+
+size_t TOTPManager::generate_totp(std::string_view account_name, uint64_t unix_time, std::span<char> output) const
+{
+	return generate_from(*this->snapshot(), account_name, unix_time, output);
+}
+
+size_t TOTPManager::generate_all(uint64_t unix_time, std::span<uint32_t> codes) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	current->accounts.generate_all(unix_time, codes);
+
+	return std::min(codes.size(), current->accounts.size());
+}
+
+size_t TOTPManager::generate_range(std::string_view account_name, uint64_t t0, uint64_t t1, std::span<uint32_t> codes) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	AccountId id = current->accounts.find(account_name);
+	if (id == d_invalid_account_id)
 	{
-		CppTotp::Bytes::ByteString secret_bytes = CppTotp::Bytes::fromUnpaddedBase32(normalizedKey);
-		uint32_t				   code_val		= CppTotp::totp(secret_bytes, time(NULL), 0, 30, 6);
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to generate TOTP range for account '{}': account not found", account_name));
+		return 0;
+	}
+
+	return current->accounts.generate_range(id, t0, t1, codes);
+}
+
+size_t TOTPManager::generate_range(std::string_view account_name, uint64_t t0, uint64_t t1, std::ostream& output) const
+{
+	std::shared_ptr<const AccountSnapshot> current	= this->snapshot();
+	const AccountStore&					   accounts = current->accounts;
+
+	AccountId id = accounts.find(account_name);
+	if (id == d_invalid_account_id)
+	{
+		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to generate TOTP range for account '{}': account not found", account_name));
+		return 0;
+	}
+
+	const AccountParameters parameters = accounts.get_parameters(id);
+
+	// Generate and format a chunk at a time so a day or a year of codes never needs a full buffer.
+	constexpr size_t d_range_chunk_size = 512;
+
+	uint32_t	codes[d_range_chunk_size];
+	std::string text;
+	text.reserve(d_range_chunk_size * 32);
+
+	size_t written = 0;
+	for (uint64_t step = t0 / parameters.period; step <= t1 / parameters.period;)
+	{
+		const uint64_t step_start = step * parameters.period;
+		const size_t   count	  = accounts.generate_range(id, step_start, t1, codes);
+
+		text.clear();
+		for (size_t i = 0; i < count; ++i)
+		{
+			char   code[d_max_code_digits];
+			size_t size = format_code(codes[i], parameters.digits, code);
+
+			fmt::format_to(std::back_inserter(text), "{} {}\n", step_start + i * parameters.period, std::string_view(code, size));
+		}
 
-		std::string code_str = std::to_string(code_val);
-		if (code_str.length() < 6)
+		output.write(text.data(), static_cast<std::streamsize>(text.size()));
+		if (!output)
 		{
-			code_str.insert(0, 6 - code_str.length(), '0');
+			SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to write TOTP range for account '{}'.", account_name));
+			break;
 		}
-		return code_str;
+
+		written += count;
+		step += count;
 	}
-	catch (const std::exception& e)
+
+	return written;
+}
+
+size_t TOTPManager::generate_batch(std::span<const GenerateRequest> requests, std::span<uint32_t> codes) const
+{
+	std::shared_ptr<const AccountSnapshot> current	= this->snapshot();
+	const AccountStore&					   accounts = current->accounts;
+
+	const size_t count = std::min(requests.size(), codes.size());
+
+	std::call_once(m_batch_pool_once, [this] { m_batch_pool = std::make_unique<WorkStealingPool>(); });
+
+	std::atomic<size_t> generated = 0;
+
+	m_batch_pool->parallel_for(count, d_batch_chunk_size, [&](size_t begin, size_t end) {
+		// Exports usually list each account's timestamps together; skip the lookup for repeats.
+		std::string_view last_name;
+		AccountId		 id		   = d_invalid_account_id;
+		size_t			 succeeded = 0;
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (i == begin || requests[i].account_name != last_name)
+			{
+				last_name = requests[i].account_name;
+				id		  = accounts.find(last_name);
+			}
+
+			if (id == d_invalid_account_id)
+			{
+				codes[i] = d_invalid_batch_code;
+				continue;
+			}
+
+			codes[i] = accounts.generate(id, requests[i].unix_time);
+			++succeeded;
+		}
+
+		generated.fetch_add(succeeded, std::memory_order_relaxed);
+	});
+
+	if (generated.load(std::memory_order_relaxed) != count)
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils,
+					   fmt::format("Batch generation skipped {} requests for unknown accounts.", count - generated.load(std::memory_order_relaxed)));
+	}
+
+	return generated.load(std::memory_order_relaxed);
+}
+
+std::optional<int32_t> TOTPManager::verify_against(const AccountSnapshot& snapshot,
+													std::string_view	   account_name,
+													std::string_view	   code,
+													uint64_t			   unix_time,
+													uint32_t			   window) const
+{
+	const AccountStore& accounts = snapshot.accounts;
+
+	AccountId id = accounts.find(account_name);
+	if (id == d_invalid_account_id)
+	{
+		SPD_DEBUG_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to verify TOTP for account '{}': account not found", account_name));
+		return std::nullopt;
+	}
+
+	const AccountParameters parameters = accounts.get_parameters(id);
+
+	std::optional<uint32_t> parsed = parse_code(code, parameters.digits);
+	if (!parsed)
+	{
+		return std::nullopt;
+	}
+
+	std::optional<int32_t> offset = accounts.verify(id, unix_time, *parsed, window);
+	if (!offset)
+	{
+		return std::nullopt;
+	}
+
+	const uint64_t counter = unix_time / parameters.period + *offset;
+	if (!m_replay_cache.accept(accounts.get_serial(id), parameters.period, counter))
+	{
+		SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Rejected replayed TOTP for account '{}'.", account_name));
+		return std::nullopt;
+	}
+
+	return offset;
+}
+
+std::optional<int32_t> TOTPManager::verify(std::string_view account_name, std::string_view code, uint32_t window) const
+{
+	return verify(account_name, code, static_cast<uint64_t>(time(NULL)), window);
+}
+
+std::optional<int32_t> TOTPManager::verify(std::string_view account_name, std::string_view code, uint64_t unix_time, uint32_t window) const
+{
+	return verify_against(*this->snapshot(), account_name, code, unix_time, window);
+}
+
+void TOTPManager::verify_batch(std::span<const VerifyRequest>	 requests,
+							   uint64_t							 unix_time,
+							   uint32_t							 window,
+							   std::span<std::optional<int32_t>> results) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	const size_t count = std::min(requests.size(), results.size());
+
+	for (size_t i = 0; i < count; ++i)
 	{
-		SPD_ERROR_CLASS(COMMON::d_settings_group_utils, fmt::format("Failed to generate TOTP for account '{}': {}", current_name, e.what()));
-		return "";
+		results[i] = verify_against(*current, requests[i].account_name, requests[i].code, unix_time, window);
 	}
 }
 
+std::vector<std::string> TOTPManager::find_accounts(std::string_view code, uint64_t unix_time, uint32_t window) const
+{
+	std::optional<uint32_t> parsed = parse_code(code, static_cast<uint32_t>(code.size()));
+	if (!parsed)
+	{
+		return {};
+	}
+
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+	std::lock_guard<std::mutex>			   lock(m_code_index_mutex);
+
+	// Rebuild on step rollover, and whenever the index was built from an older snapshot.
+	if (m_code_index_source != current || !m_code_index.is_current(unix_time, window))
+	{
+		m_code_index.build(current->accounts, unix_time, window);
+		m_code_index_source = current;
+	}
+
+	// A code rarely matches more than a few accounts; when it does, every match is fetched again.
+	CodeMatch			   buffer[16];
+	std::vector<CodeMatch> overflow;
+	std::span<CodeMatch>   matches(buffer);
+
+	size_t found = m_code_index.find(*parsed, static_cast<uint32_t>(code.size()), matches);
+	if (found > matches.size())
+	{
+		overflow.resize(found);
+		matches = overflow;
+		found	= m_code_index.find(*parsed, static_cast<uint32_t>(code.size()), matches);
+	}
+
+	std::vector<std::string> names;
+	names.reserve(found);
+	for (size_t i = 0; i < found; ++i)
+	{
+		names.emplace_back(current->accounts.get_name(matches[i].id));
+	}
+
+	return names;
+}
+
 bool TOTPManager::set_account(const std::string& account_name, const std::string& secret)
 {
 	if (account_name.empty() || secret.empty())
@@ -105,27 +567,116 @@ bool TOTPManager::set_account(const std::string& account_name, const std::string
 		return false;
 	}
 
-	m_account_name	 = account_name;
-	m_account_secret = secret;
+	{
+		std::lock_guard<std::mutex> lock(m_totp_mutex);
+
+		auto	  next = std::make_shared<AccountSnapshot>(*this->snapshot());
+		AccountId id   = next->accounts.add(account_name, secret, next->default_parameters);
+		if (id == d_invalid_account_id)
+		{
+			return false;
+		}
+
+		AccountVault vault;
+		if (!m_vault_path.empty() && (!vault.open(m_vault_path) || !vault.put(account_name, secret, next->accounts.get_parameters(id))))
+		{
+			return false;
+		}
+
+		next->account_name = account_name;
+		this->publish(std::move(next));
+	}
 
 	save_account();
 	SPD_INFO_CLASS(COMMON::d_settings_group_utils, fmt::format("TOTP account set to '{}'.", account_name));
 	return true;
 }
 
-void TOTPManager::clear_account()
+bool TOTPManager::select_account(const std::string& account_name)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_totp_mutex);
+
+		std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+		if (current->accounts.find(account_name) == d_invalid_account_id)
+		{
+			SPD_WARN_CLASS(COMMON::d_settings_group_utils, fmt::format("Account '{}' is not configured.", account_name));
+			return false;
+		}
+
+		auto next		   = std::make_shared<AccountSnapshot>(*current);
+		next->account_name = account_name;
+		this->publish(std::move(next));
+	}
+
+	return true;
+}
+
+bool TOTPManager::clear_account()
 {
 	{
 		std::lock_guard<std::mutex> lock(m_totp_mutex);
-		m_account_name.clear();
-		m_account_secret.clear();
+
+		auto next = std::make_shared<AccountSnapshot>(*this->snapshot());
+
+		AccountVault vault;
+		if (!m_vault_path.empty()
+			&& (!vault.open(m_vault_path) || (vault.find(next->account_name) && !vault.remove(next->account_name))))
+		{
+			return false;
+		}
+
+		next->accounts.remove(next->account_name);
+		next->account_name = next->accounts.empty() ? "" : std::string(next->accounts.get_name(0));
+		this->publish(std::move(next));
 	}
+
 	save_account();
+	return true;
 }
 
 std::string TOTPManager::get_account_name() const
 {
-	return m_account_name;
+	return this->snapshot()->account_name;
+}
+
+AccountParameters TOTPManager::get_account_parameters() const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	AccountId id = current->accounts.find(current->account_name);
+	return id != d_invalid_account_id ? current->accounts.get_parameters(id) : current->default_parameters;
+}
+
+std::optional<AccountParameters> TOTPManager::get_account_parameters(std::string_view account_name) const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	AccountId id = current->accounts.find(account_name);
+	if (id == d_invalid_account_id)
+	{
+		return std::nullopt;
+	}
+
+	return current->accounts.get_parameters(id);
+}
+
+std::vector<std::string> TOTPManager::get_account_names() const
+{
+	std::shared_ptr<const AccountSnapshot> current = this->snapshot();
+
+	std::vector<std::string> names;
+	names.reserve(current->accounts.size());
+	for (AccountId id = 0; id < current->accounts.size(); ++id)
+	{
+		names.emplace_back(current->accounts.get_name(id));
+	}
+	return names;
+}
+
+size_t TOTPManager::get_account_count() const
+{
+	return this->snapshot()->accounts.size();
 }
 
 } // namespace UTILS
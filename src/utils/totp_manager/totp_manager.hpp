@@ -1,15 +1,57 @@
 #ifndef TOTP_MANAGER_HPP
 #define TOTP_MANAGER_HPP
 
+#include "account_store.hpp"
+#include "account_vault.hpp"
+#include "code_index.hpp"
+#include "code_scheduler.hpp"
 #include "manager_singleton.hpp"
+#include "replay_cache.hpp"
 #include "settings_manager.hpp"
+#include "thread_pool.hpp"
 
+#include <atomic>
+#include <iosfwd>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace UTILS
 {
 
+// Batch generation hands each worker this many requests at a time; 1024 requests plus their codes
+// stay within a core's L1/L2 while it works through them.
+constexpr size_t   d_batch_chunk_size	= 1024;
+constexpr uint32_t d_invalid_batch_code = UINT32_MAX;
+
+struct GenerateRequest
+{
+	std::string_view account_name;
+	uint64_t		 unix_time;
+};
+
+struct VerifyRequest
+{
+	std::string_view account_name;
+	std::string_view code;
+};
+
+// Immutable view of the configured accounts. Readers pick up the current one with a single atomic
+// load and keep it alive for as long as they use it; writers copy it, modify the copy and publish
+// it in one atomic store, so generation never blocks on or races with account changes.
+struct AccountSnapshot
+{
+	AccountStore	  accounts;
+	std::string		  account_name;
+	AccountParameters default_parameters;
+
+	// Current and next step codes of the accounts above, kept up to date by precompute_codes().
+	CodeCache codes;
+};
+
 class TOTPManager : public UTILS::ManagerSingleton<TOTPManager>
 {
 	friend class ManagerSingleton<TOTPManager>;
@@ -24,24 +66,110 @@ public:
 	~TOTPManager();
 
 	std::string generate_totp();
+	std::string generate_totp(std::string_view account_name);
+	size_t		generate_all(uint64_t unix_time, std::span<uint32_t> codes) const;
+
+	// Heap-free variants for hot paths. The numeric overload leaves padding to the caller, the
+	// buffer overloads write exactly `digits` characters (no terminator) and return that count,
+	// or 0 on failure. A d_max_code_digits buffer always fits.
+	std::optional<uint32_t> generate_code(std::string_view account_name, uint64_t unix_time) const;
+	size_t					generate_totp(uint64_t unix_time, std::span<char> output) const;
+	size_t					generate_totp(std::string_view account_name, uint64_t unix_time, std::span<char> output) const;
+
+	// Rolls the per-step code cache forward to unix_time: accounts read since the last call join the
+	// schedule, and every account whose step ended gets the next step's code. Returns the earliest
+	// upcoming rollover so an event loop can sleep until it. Only this call moves the schedule, so
+	// drive it from the wall clock; code reads are served from the cache without taking a lock.
+	std::optional<uint64_t> precompute_codes(uint64_t unix_time) const;
+
+	// One account's codes for every time step from the one containing t0 through the one containing
+	// t1, generated from the cached key state. The span overload writes up to codes.size() codes and
+	// returns how many it wrote; the stream overload writes "<step start> <code>" lines in chunks
+	// and returns the number of lines.
+	size_t generate_range(std::string_view account_name, uint64_t t0, uint64_t t1, std::span<uint32_t> codes) const;
+	size_t generate_range(std::string_view account_name, uint64_t t0, uint64_t t1, std::ostream& output) const;
+
+	// Returns the time-step offset the code matched at (0 is the current step), or nullopt if it
+	// matched none within +-window steps. The window is capped at d_max_verify_window. A code is
+	// accepted only once per account and time step; replays return nullopt.
+	std::optional<int32_t> verify(std::string_view account_name, std::string_view code, uint32_t window = 1) const;
+	std::optional<int32_t> verify(std::string_view account_name, std::string_view code, uint64_t unix_time, uint32_t window) const;
+
+	// Names of the accounts whose code at unix_time, or within +-window steps of it, equals code.
+	// Answered from a reverse index that is rebuilt once any account's step rolls over, so the
+	// lookup itself costs no HMACs. Follow up with verify() to consume the code.
+	std::vector<std::string> find_accounts(std::string_view code, uint64_t unix_time, uint32_t window = 1) const;
+
+	// Generates codes for many (account, time) pairs against one snapshot, spread over a
+	// work-stealing pool sized to the host. codes[i] answers requests[i] and is set to
+	// d_invalid_batch_code for unknown accounts. Returns the number of codes generated.
+	size_t generate_batch(std::span<const GenerateRequest> requests, std::span<uint32_t> codes) const;
+
+	// Verifies many pairs against one snapshot; results[i] answers requests[i].
+	void verify_batch(std::span<const VerifyRequest>	 requests,
+					  uint64_t							 unix_time,
+					  uint32_t							 window,
+					  std::span<std::optional<int32_t>> results) const;
 
 	bool set_account(const std::string& account_name, const std::string& secret);
-	void clear_account();
+	bool select_account(const std::string& account_name);
+	bool clear_account();
 
-	std::string get_account_name() const;
+	std::string						 get_account_name() const;
+	AccountParameters				 get_account_parameters() const;
+	std::optional<AccountParameters> get_account_parameters(std::string_view account_name) const;
+	std::vector<std::string>		 get_account_names() const;
+	size_t							 get_account_count() const;
 
 private:
 	void load_account();
 	void save_account();
 
+	std::shared_ptr<const AccountSnapshot> snapshot() const;
+
+	// Sizes the snapshot's code cache and makes it current. Callers hold m_totp_mutex.
+	void publish(std::shared_ptr<AccountSnapshot> next);
+
+	// Callers hold m_code_scheduler_mutex.
+	void sync_code_scheduler(const std::shared_ptr<const AccountSnapshot>& snapshot) const;
+
+	uint32_t cached_code(const AccountSnapshot& snapshot, AccountId id, uint64_t unix_time) const;
+	size_t	 generate_from(const AccountSnapshot& snapshot, std::string_view account_name, uint64_t unix_time, std::span<char> output) const;
+	std::optional<int32_t> verify_against(const AccountSnapshot& snapshot,
+										  std::string_view		 account_name,
+										  std::string_view		 code,
+										  uint64_t				 unix_time,
+										  uint32_t				 window) const;
+
 private:
-	std::string m_account_name;
-	std::string m_account_secret;
+	std::atomic<std::shared_ptr<const AccountSnapshot>> m_snapshot {std::make_shared<const AccountSnapshot>()};
+
+	mutable ReplayCache							   m_replay_cache;
+	mutable CodeIndex							   m_code_index;
+	mutable std::shared_ptr<const AccountSnapshot> m_code_index_source;
+	mutable CodeScheduler						   m_code_scheduler;
+	mutable std::shared_ptr<const AccountSnapshot> m_code_scheduler_source;
+
+	// Started on the first generate_batch() so interactive use never spawns threads.
+	mutable std::unique_ptr<WorkStealingPool> m_batch_pool;
+	mutable std::once_flag					  m_batch_pool_once;
 
 	std::shared_ptr<UTILS::SettingsManager> m_settings_manager;
+	SubscriptionId							m_settings_subscription = 0;
+
+	// totp.vault; when set, accounts live in this AccountVault instead of totp.accounts. Guarded by
+	// m_totp_mutex.
+	fs::path m_vault_path;
+
+	// totp.accounts entries load_account() could not use, kept as written by save_account() so they
+	// can be corrected. Guarded by m_totp_mutex.
+	std::vector<std::string> m_rejected_accounts;
 
 protected:
+	// Serialises writers (snapshot replacement and settings saves); readers never take it.
 	mutable std::mutex m_totp_mutex;
+	mutable std::mutex m_code_index_mutex;
+	mutable std::mutex m_code_scheduler_mutex;
 };
 
 } // namespace UTILS
@@ -0,0 +1,158 @@
+#include "code_table.hpp"
+#include "code_table_publisher.hpp"
+#include "test_support.hpp"
+#include "totp_manager.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Readers look accounts up in a shared code table while the publisher keeps rewriting it: every
+// publish moves the clock forward and rotates one account's secret, and new accounts make the table
+// grow and be replaced. Each entry a reader gets must be one whole publish of that account, so its
+// name, step and both codes have to agree with one of the account's two secrets.
+
+namespace
+{
+constexpr uint64_t d_unix_time			 = 1'700'000'000;
+constexpr size_t   d_initial_accounts	 = 8;
+constexpr size_t   d_final_accounts		 = 100;
+constexpr size_t   d_publish_iterations = 2'000;
+
+std::string account_name(size_t index)
+{
+	return "account-" + std::to_string(index);
+}
+
+// Two distinct base32 secrets per account.
+std::string account_secret(size_t index, size_t variant)
+{
+	constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+	std::string secret(16, 'A');
+	for (size_t i = 0; i < secret.size(); ++i)
+	{
+		secret[i] = alphabet[(index * 7 + i * 3 + variant * 11) % alphabet.size()];
+	}
+	return secret;
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated() || !TESTS::write_settings("[totp]\naccount_name = \"\"\n"))
+	{
+		return 1;
+	}
+
+	const std::string path = std::string(std::getenv("PROJECT_TEST_HOME")) + "/stress.codes";
+
+	auto manager = UTILS::TOTPManager::instance();
+
+	// Every secret an account may be published with, as "<name>/<variant>".
+	UTILS::AccountStore reference;
+	for (size_t i = 0; i < d_final_accounts; ++i)
+	{
+		reference.add(account_name(i) + "/0", account_secret(i, 0), {});
+		reference.add(account_name(i) + "/1", account_secret(i, 1), {});
+	}
+
+	for (size_t i = 0; i < d_initial_accounts; ++i)
+	{
+		manager->set_account(account_name(i), account_secret(i, 0));
+	}
+
+	UTILS::CodeTablePublisher publisher;
+	TESTS::expect(publisher.open(path), "publisher opens the table");
+	TESTS::expect(publisher.publish(*manager, d_unix_time), "first publish");
+
+	std::atomic<bool>	done  = false;
+	std::atomic<size_t> reads = 0;
+	std::atomic<size_t> found = 0;
+
+	const size_t			 reader_count = std::max(3u, std::thread::hardware_concurrency()) - 1;
+	std::vector<std::thread> readers;
+
+	for (size_t reader = 0; reader < reader_count; ++reader)
+	{
+		readers.emplace_back([&, reader] {
+			TOTPCLIENT::CodeTableReader table;
+			TESTS::expect(table.open(path), "reader opens the table");
+
+			size_t local_reads = 0;
+			size_t local_found = 0;
+
+			for (size_t i = reader; !done.load(std::memory_order_relaxed); ++i, ++local_reads)
+			{
+				const size_t					 index = i % d_final_accounts;
+				const std::string				 name  = account_name(index);
+				std::optional<TOTPCLIENT::CodeTableEntry> entry = table.find(name);
+
+				if (!entry)
+				{
+					TESTS::expect(index >= d_initial_accounts, "initial accounts are always found");
+					continue;
+				}
+
+				++local_found;
+
+				TESTS::expect(TOTPCLIENT::entry_account(*entry) == name, "entry belongs to the account looked up");
+				TESTS::expect(entry->period == 30 && entry->digits == 6 && entry->valid_from % 30 == 0, "entry parameters");
+
+				bool whole = false;
+				for (size_t variant = 0; variant < 2 && !whole; ++variant)
+				{
+					const UTILS::AccountId id = reference.find(name + "/" + std::to_string(variant));
+					whole = entry->code == reference.generate(id, entry->valid_from) && entry->next_code == reference.generate(id, entry->valid_from + 30);
+				}
+				TESTS::expect(whole, "step and codes come from one publish");
+			}
+
+			reads.fetch_add(local_reads, std::memory_order_relaxed);
+			found.fetch_add(local_found, std::memory_order_relaxed);
+		});
+	}
+
+	size_t account_count = d_initial_accounts;
+	for (size_t i = 1; i <= d_publish_iterations; ++i)
+	{
+		if (i % (d_publish_iterations / (d_final_accounts - d_initial_accounts)) == 0 && account_count < d_final_accounts)
+		{
+			manager->set_account(account_name(account_count), account_secret(account_count, 0));
+			++account_count;
+		}
+		else
+		{
+			const size_t index = i % account_count;
+			manager->set_account(account_name(index), account_secret(index, i / account_count % 2));
+		}
+
+		TESTS::expect(publisher.publish(*manager, d_unix_time + i * 7), "publish");
+	}
+
+	done.store(true, std::memory_order_relaxed);
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	publisher.close();
+
+	TESTS::expect(account_count == d_final_accounts, "every account was added");
+	TESTS::expect(found.load() > 0, "readers found entries while the table changed");
+
+	std::printf("%zu readers, %zu lookups, %zu found, %zu publishes, %d failures\n",
+				reader_count,
+				reads.load(),
+				found.load(),
+				d_publish_iterations,
+				TESTS::failure_count().load());
+
+	return TESTS::failure_count().load() != 0;
+}
@@ -0,0 +1,105 @@
+#include "test_support.hpp"
+#include "totp_manager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Readers generate codes and read the selected account while a writer keeps rotating secrets and
+// switching accounts. Every answer must come from one published snapshot: a code that matches none
+// of the secrets an account ever had, or a name that was never selected, means a torn read.
+
+namespace
+{
+constexpr uint64_t d_unix_time		   = 1'700'000'000;
+constexpr size_t   d_writer_iterations = 500;
+
+constexpr std::string_view d_secret_a = "JBSWY3DPEHPK3PXP";
+constexpr std::string_view d_secret_b = "GEZDGNBVGY3TQOJQ";
+constexpr std::string_view d_secret_c = "MFRGGZDFMZTWQ2LK";
+
+std::string code_for(const UTILS::TOTPManager& manager, std::string_view account_name)
+{
+	std::array<char, UTILS::d_max_code_digits> buffer {};
+	return std::string(buffer.data(), manager.generate_totp(account_name, d_unix_time, buffer));
+}
+
+} // namespace
+
+int main()
+{
+	spdlog::set_level(spdlog::level::warn);
+
+	if (!TESTS::isolated() || !TESTS::write_settings("[totp]\naccount_name = \"\"\n"))
+	{
+		return 1;
+	}
+
+	auto manager = UTILS::TOTPManager::instance();
+
+	// The codes each secret yields at d_unix_time; "alpha" rotates between the first two.
+	manager->set_account("alpha", std::string(d_secret_c));
+	const std::string alpha_c = code_for(*manager, "alpha");
+	manager->set_account("alpha", std::string(d_secret_a));
+	const std::string alpha_a = code_for(*manager, "alpha");
+	manager->set_account("beta", std::string(d_secret_b));
+	const std::string beta_b = code_for(*manager, "beta");
+
+	TESTS::expect(!alpha_a.empty() && !alpha_c.empty() && !beta_b.empty(), "setup generates codes");
+	TESTS::expect(alpha_a != alpha_c, "the two alpha secrets differ at the test time");
+
+	std::atomic<bool> done = false;
+
+	const size_t			 reader_count = std::max(3u, std::thread::hardware_concurrency()) - 1;
+	std::vector<std::thread> readers;
+	std::atomic<size_t>		 reads = 0;
+
+	for (size_t reader = 0; reader < reader_count; ++reader)
+	{
+		readers.emplace_back([&] {
+			std::array<char, UTILS::d_max_code_digits> buffer {};
+			size_t									   local_reads = 0;
+
+			while (!done.load(std::memory_order_relaxed))
+			{
+				const std::string name = manager->get_account_name();
+				TESTS::expect(name == "alpha" || name == "beta", "selected account is one that was set");
+
+				const std::string selected(buffer.data(), manager->generate_totp(d_unix_time, buffer));
+				TESTS::expect(selected == alpha_a || selected == alpha_c || selected == beta_b, "selected account's code matches a secret");
+
+				const std::string alpha = code_for(*manager, "alpha");
+				TESTS::expect(alpha == alpha_a || alpha == alpha_c, "alpha's code matches one of its secrets");
+
+				TESTS::expect(code_for(*manager, "beta") == beta_b, "beta's code never changes");
+
+				++local_reads;
+			}
+
+			reads.fetch_add(local_reads, std::memory_order_relaxed);
+		});
+	}
+
+	for (size_t i = 0; i < d_writer_iterations; ++i)
+	{
+		manager->set_account("alpha", std::string(i % 2 ? d_secret_a : d_secret_c));
+		manager->select_account(i % 3 ? "beta" : "alpha");
+	}
+
+	done.store(true, std::memory_order_relaxed);
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	TESTS::expect(reads.load() > 0, "readers ran while the writer did");
+
+	std::printf("%zu readers, %zu reads, %zu rotations, %d failures\n", reader_count, reads.load(), d_writer_iterations, TESTS::failure_count().load());
+
+	return TESTS::failure_count().load() != 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TEST_SUPPORT_HPP
+#define TEST_SUPPORT_HPP
+
+#include "spdlog_wrapper.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace TESTS
+{
+// Tests and benchmarks change the settings they run against, so they only run where ctest points
+// HOME and XDG_CONFIG_HOME at a directory of the build tree (see cmake/utils/tests.cmake).
+inline bool isolated()
+{
+	const char* test_home	= std::getenv("PROJECT_TEST_HOME");
+	const char* config_home = std::getenv("XDG_CONFIG_HOME");
+
+	if (!test_home || !config_home || std::string_view(test_home) != config_home)
+	{
+		std::fputs("Refusing to run outside ctest: it would change the user's settings.\n", stderr);
+		return false;
+	}
+
+	return true;
+}
+
+// Replaces the settings file the managers will load. Call before the first instance().
+inline bool write_settings(std::string_view contents)
+{
+	const std::filesystem::path directory = std::filesystem::path(std::getenv("XDG_CONFIG_HOME")) / COMMON::d_project_name;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	std::ofstream file(directory / (std::string(COMMON::d_project_name) + ".toml"), std::ios::trunc);
+	file << contents;
+	return file.good();
+}
+
+// Failed expectations so far; expect() may be called from several threads at once.
+inline std::atomic<int>& failure_count()
+{
+	static std::atomic<int> count = 0;
+	return count;
+}
+
+inline void expect(bool condition, std::string_view what)
+{
+	if (!condition)
+	{
+		failure_count().fetch_add(1, std::memory_order_relaxed);
+		std::fprintf(stderr, "FAILED: %.*s\n", static_cast<int>(what.size()), what.data());
+	}
+}
+
+// Wall-clock seconds taken by body().
+template<typename Body>
+double seconds(Body&& body)
+{
+	const auto start = std::chrono::steady_clock::now();
+	body();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace TESTS
+
+#endif // TEST_SUPPORT_HPP